@@ -0,0 +1,477 @@
+////////////////////////////////////////////////////////////////////////////
+// Heap allocation accounting.
+//
+// Including this header replaces the global operator new and operator
+// delete of the program with versions that call malloc and free and
+// count the allocations, the freed blocks and their sizes in counters
+// of the calling thread; a program opts in by including it (once).
+// The counters of a thread are written only by that thread, so
+// counting does not contend between threads.
+//
+// An AllocationScope measures the allocations made from its creation:
+// by the calling thread, including the peak of the bytes it holds, or
+// by all threads (without the peak), e.g., around a parallel parse.
+//
+// Example:
+//   AllocTracker::AllocationScope scope;
+//   Solve();
+//   AllocTracker::Stats stats = scope.Stop();
+//   AllocTracker::Print(std::cout, "solve", stats);
+//   std::cout << AllocTracker::PeakRss();
+//
+
+#ifndef _alloc_tracker_h_
+#define _alloc_tracker_h_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define ALLOC_TRACKER_BLOCK_SIZE(p) malloc_usable_size(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define ALLOC_TRACKER_BLOCK_SIZE(p) malloc_size(p)
+#endif
+
+namespace AllocTracker
+{
+   // Byte counts are the usable sizes of the blocks where the allocator
+   // reports them, and the requested sizes (with no freed bytes) where
+   // it does not.
+   struct Stats
+   {
+      uint64_t allocations = 0;
+      uint64_t deallocations = 0;
+      uint64_t bytes = 0;
+      uint64_t freedBytes = 0;
+
+      // The largest increase of the bytes held by the thread;
+      // -1 if not measured.
+      int64_t peakLiveBytes = -1;
+   };
+
+   // The counters of one thread. They are never freed, so that the
+   // counts of threads that have exited remain in ProcessStats.
+   struct ThreadCounters
+   {
+      std::atomic<uint64_t> allocations{0};
+      std::atomic<uint64_t> deallocations{0};
+      std::atomic<uint64_t> bytes{0};
+      std::atomic<uint64_t> freedBytes{0};
+      int64_t liveBytes = 0;
+      int64_t peakLiveBytes = 0;
+      ThreadCounters* next = nullptr;
+   };
+
+   // The counters of the calling thread.
+   ThreadCounters& GetThreadCounters();
+
+   // The counts of the calling thread, or the sums over all threads
+   // (without the peak), since the start of the program.
+   Stats ThreadStats();
+   Stats ProcessStats();
+
+   class AllocationScope
+   {
+   public:
+      enum class Threads
+      {
+         Calling,
+         All
+      };
+
+   public:
+      AllocationScope(Threads threads = Threads::Calling);
+      ~AllocationScope();
+
+      AllocationScope(const AllocationScope&) = delete;
+      AllocationScope& operator=(const AllocationScope&) = delete;
+
+      // The counts since the scope was created; must be called once,
+      // on the thread that created the scope.
+      Stats Stop();
+
+   private:
+      Threads threads;
+      Stats start;
+      int64_t startLiveBytes;
+      int64_t outerPeakLiveBytes;
+      bool bStopped;
+   };
+
+   // The peak resident set size of the process in bytes (getrusage);
+   // 0 if not available.
+   uint64_t PeakRss();
+
+   void Print(std::ostream& out, const char* phase, const Stats& stats);
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   namespace Detail
+   {
+      std::atomic<ThreadCounters*>& GetCounterList()
+      {
+         static std::atomic<ThreadCounters*> head{nullptr};
+         return head;
+      }
+
+      // Allocated with malloc, not new, which would count itself.
+      ThreadCounters* RegisterThread()
+      {
+         void* memory = std::malloc(sizeof(ThreadCounters));
+         if (memory == nullptr) std::abort();
+
+         ThreadCounters* counters = new (memory) ThreadCounters();
+
+         std::atomic<ThreadCounters*>& head = GetCounterList();
+         counters->next = head.load(std::memory_order_relaxed);
+         while (!head.compare_exchange_weak(counters->next, counters, std::memory_order_release, std::memory_order_relaxed))
+         {
+            //empty
+         }
+
+         return counters;
+      }
+
+      // Only the owner thread writes its counters: a relaxed load and
+      // store is enough, and cheaper than an atomic increment.
+      inline void Increment(std::atomic<uint64_t>& counter, uint64_t value)
+      {
+         counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+      }
+
+      inline void CountAllocation(void* p, size_t size)
+      {
+         if (p == nullptr) return;
+
+#ifdef ALLOC_TRACKER_BLOCK_SIZE
+         size = ALLOC_TRACKER_BLOCK_SIZE(p);
+#endif
+
+         ThreadCounters& counters = GetThreadCounters();
+         Increment(counters.allocations, 1);
+         Increment(counters.bytes, size);
+
+         counters.liveBytes += static_cast<int64_t>(size);
+         counters.peakLiveBytes = std::max(counters.peakLiveBytes, counters.liveBytes);
+      }
+
+      inline void CountDeallocation(void* p)
+      {
+         if (p == nullptr) return;
+
+         ThreadCounters& counters = GetThreadCounters();
+         Increment(counters.deallocations, 1);
+
+#ifdef ALLOC_TRACKER_BLOCK_SIZE
+         size_t size = ALLOC_TRACKER_BLOCK_SIZE(p);
+         Increment(counters.freedBytes, size);
+         counters.liveBytes -= static_cast<int64_t>(size);
+#endif
+      }
+
+      inline void* Allocate(size_t size)
+      {
+         void* p = std::malloc((size == 0) ? 1 : size);
+         CountAllocation(p, size);
+         return p;
+      }
+
+      inline void* AllocateAligned(size_t size, size_t alignment)
+      {
+         void* p = nullptr;
+         alignment = std::max(alignment, sizeof(void*));
+
+         if (posix_memalign(&p, alignment, (size == 0) ? 1 : size) != 0) p = nullptr;
+
+         CountAllocation(p, size);
+         return p;
+      }
+
+// GCC warns when it inlines operator delete into code that calls
+// operator new: it sees free called on memory from new.
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+      inline void Free(void* p)
+      {
+         CountDeallocation(p);
+         std::free(p);
+      }
+
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic pop
+#endif
+   }
+
+   ThreadCounters& GetThreadCounters()
+   {
+      thread_local ThreadCounters* counters = Detail::RegisterThread();
+      return *counters;
+   }
+
+   Stats ThreadStats()
+   {
+      const ThreadCounters& counters = GetThreadCounters();
+
+      Stats stats;
+      stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+      stats.deallocations = counters.deallocations.load(std::memory_order_relaxed);
+      stats.bytes = counters.bytes.load(std::memory_order_relaxed);
+      stats.freedBytes = counters.freedBytes.load(std::memory_order_relaxed);
+      stats.peakLiveBytes = counters.peakLiveBytes;
+
+      return stats;
+   }
+
+   Stats ProcessStats()
+   {
+      Stats stats;
+
+      const ThreadCounters* counters = Detail::GetCounterList().load(std::memory_order_acquire);
+      for (; counters != nullptr; counters = counters->next)
+      {
+         stats.allocations += counters->allocations.load(std::memory_order_relaxed);
+         stats.deallocations += counters->deallocations.load(std::memory_order_relaxed);
+         stats.bytes += counters->bytes.load(std::memory_order_relaxed);
+         stats.freedBytes += counters->freedBytes.load(std::memory_order_relaxed);
+      }
+
+      return stats;
+   }
+
+   // The peak of the thread is restarted for the scope and restored
+   // (as the larger of the two) when it stops, so scopes can be nested.
+   AllocationScope::AllocationScope(Threads threads) :
+      threads(threads), bStopped(false)
+   {
+      ThreadCounters& counters = GetThreadCounters();
+
+      startLiveBytes = counters.liveBytes;
+      outerPeakLiveBytes = counters.peakLiveBytes;
+      counters.peakLiveBytes = counters.liveBytes;
+
+      start = (threads == Threads::Calling) ? ThreadStats() : ProcessStats();
+   }
+
+   AllocationScope::~AllocationScope()
+   {
+      if (!bStopped) Stop();
+   }
+
+   Stats AllocationScope::Stop()
+   {
+      Stats now = (threads == Threads::Calling) ? ThreadStats() : ProcessStats();
+
+      ThreadCounters& counters = GetThreadCounters();
+      int64_t peak = counters.peakLiveBytes;
+      counters.peakLiveBytes = std::max(outerPeakLiveBytes, peak);
+      bStopped = true;
+
+      Stats stats;
+      stats.allocations = now.allocations - start.allocations;
+      stats.deallocations = now.deallocations - start.deallocations;
+      stats.bytes = now.bytes - start.bytes;
+      stats.freedBytes = now.freedBytes - start.freedBytes;
+      stats.peakLiveBytes = (threads == Threads::Calling) ? (peak - startLiveBytes) : -1;
+
+      return stats;
+   }
+
+   uint64_t PeakRss()
+   {
+#if defined(__unix__) || defined(__APPLE__)
+      rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+#if defined(__APPLE__)
+      return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+      return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+      return 0;
+#endif
+   }
+
+   void Print(std::ostream& out, const char* phase, const Stats& stats)
+   {
+      out << "  " << phase << ": " << stats.allocations << " allocation(s), "
+          << stats.bytes << " bytes, " << stats.deallocations << " free(s)";
+
+      if (stats.peakLiveBytes >= 0)
+      {
+         out << ", peak " << stats.peakLiveBytes << " live bytes";
+      }
+
+      out << std::endl;
+   }
+
+   // Solves the problems once, measuring the allocations of every problem,
+   // and prints the total, the mean and the largest counts per problem.
+   template<class T, class Solver>
+   void TrackProblemSet(std::vector<T>& problems, Solver solve, std::ostream& out = std::cout)
+   {
+      Stats total;
+      Stats most;
+      size_t mostIndex = 0;
+
+      total.peakLiveBytes = 0;
+      most.peakLiveBytes = 0;
+
+      for (size_t i = 0; i < problems.size(); i++)
+      {
+         AllocationScope scope;
+         solve(problems[i]);
+         Stats stats = scope.Stop();
+
+         total.allocations += stats.allocations;
+         total.deallocations += stats.deallocations;
+         total.bytes += stats.bytes;
+         total.freedBytes += stats.freedBytes;
+         total.peakLiveBytes = std::max(total.peakLiveBytes, stats.peakLiveBytes);
+
+         if ((i == 0) || (stats.allocations > most.allocations))
+         {
+            most = stats;
+            mostIndex = i;
+         }
+      }
+
+      out << std::endl << "Allocations of the solver (" << problems.size() << " problem(s)):" << std::endl;
+      Print(out, "all problems", total);
+
+      if (!problems.empty())
+      {
+         size_t n = problems.size();
+         out << "  per problem: " << static_cast<double>(total.allocations) / n << " allocation(s), "
+             << static_cast<double>(total.bytes) / n << " bytes" << std::endl;
+         out << "  most allocations: problem #" << (mostIndex + 1) << ", "
+             << most.allocations << " allocation(s), " << most.bytes << " bytes" << std::endl;
+      }
+   }
+}
+
+// The replaceable global allocation functions.
+
+void* operator new(size_t size)
+{
+   void* p = AllocTracker::Detail::Allocate(size);
+   if (p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void* operator new[](size_t size)
+{
+   void* p = AllocTracker::Detail::Allocate(size);
+   if (p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+   return AllocTracker::Detail::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+   return AllocTracker::Detail::Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+   void* p = AllocTracker::Detail::AllocateAligned(size, static_cast<size_t>(alignment));
+   if (p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+   void* p = AllocTracker::Detail::AllocateAligned(size, static_cast<size_t>(alignment));
+   if (p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+   return AllocTracker::Detail::AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+   return AllocTracker::Detail::AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+   AllocTracker::Detail::Free(p);
+}
+
+#endif //_alloc_tracker_h_
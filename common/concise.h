@@ -1,6 +1,29 @@
 #ifndef _concise_h_
 #define _concise_h_
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "simd.h"
 
 namespace alg{
 //////////////
@@ -23,6 +46,351 @@ void sort(T& data, Compare cmp)
    std::sort(data.begin(), data.end(), cmp);
 }
 
+namespace detail
+{
+   // Runs shorter than kMinRun are extended by insertion sort.
+   constexpr std::ptrdiff_t kMinRun = 32;
+
+   // A merge switches to galloping after one run wins kMinGallop times in a row.
+   constexpr std::ptrdiff_t kMinGallop = 7;
+
+   // Data with more than one natural run per kRandomRunLength elements
+   // is treated as random by adaptive_sort.
+   constexpr std::ptrdiff_t kRandomRunLength = 16;
+
+   // Returns the end of the natural run starting at **first**: a
+   // non-decreasing or a strictly decreasing sequence. Decreasing runs
+   // are reversed in place if **bReverse** is set.
+   template<class Iter, class Compare>
+   Iter find_run(Iter first, Iter last, Compare& cmp, bool bReverse)
+   {
+      Iter it = first + 1;
+      if (it >= last) return last;
+
+      if (cmp(*it, *first))
+      {
+         do ++it; while ((it != last) && cmp(*it, *(it - 1)));
+         if (bReverse) std::reverse(first, it);
+      }
+      else
+      {
+         do ++it; while ((it != last) && !cmp(*it, *(it - 1)));
+      }
+
+      return it;
+   }
+
+   // Returns true if [first, last) consists of few natural runs.
+   // Stops early on random data.
+   template<class Iter, class Compare>
+   bool has_few_runs(Iter first, Iter last, Compare& cmp)
+   {
+      std::ptrdiff_t maxRuns = (last - first) / kRandomRunLength + 1;
+
+      for (std::ptrdiff_t runs = 1; first != last; runs++)
+      {
+         if (runs > maxRuns) return false;
+         first = find_run(first, last, cmp, false);
+      }
+
+      return true;
+   }
+
+   // Sorts [first, last), given that [first, sorted) is already sorted.
+   template<class Iter, class Compare>
+   void insertion_sort(Iter first, Iter sorted, Iter last, Compare& cmp)
+   {
+      for (Iter it = sorted; it != last; ++it)
+      {
+         Iter pos = std::upper_bound(first, it, *it, cmp);
+         std::rotate(pos, it, it + 1);
+      }
+   }
+
+   // Exponential search for the partition point of **pred** in [first, last).
+   // gallop_left starts at the left end, gallop_right at the right end;
+   // both take O(log d) steps, where d is the distance to the answer.
+   template<class Iter, class Pred>
+   Iter gallop_left(Iter first, Iter last, Pred pred)
+   {
+      std::ptrdiff_t n = last - first, lastOfs = 0, ofs = 1;
+
+      while ((ofs <= n) && pred(first[ofs - 1]))
+      {
+         lastOfs = ofs;
+         ofs = 2 * ofs;
+      }
+
+      return std::partition_point(first + lastOfs, first + std::min(ofs - 1, n), pred);
+   }
+
+   template<class Iter, class Pred>
+   Iter gallop_right(Iter first, Iter last, Pred pred)
+   {
+      std::ptrdiff_t n = last - first, lastOfs = 0, ofs = 1;
+
+      while ((ofs <= n) && !pred(last[-ofs]))
+      {
+         lastOfs = ofs;
+         ofs = 2 * ofs;
+      }
+
+      return std::partition_point(last - std::min(ofs - 1, n), last - lastOfs, pred);
+   }
+
+   // Merges adjacent sorted runs [first, mid) and [mid, last), when the left
+   // run is not longer than the right one. The left run is moved to **buffer**.
+   template<class Iter, class Compare, class Buffer>
+   void merge_lo(Iter first, Iter mid, Iter last, Compare& cmp, Buffer& buffer)
+   {
+      buffer.assign(std::make_move_iterator(first), std::make_move_iterator(mid));
+
+      auto left = buffer.begin();
+      auto leftEnd = buffer.end();
+      Iter right = mid;
+      Iter dest = first;
+      std::ptrdiff_t leftWins = 0, rightWins = 0;
+
+      while ((left != leftEnd) && (right != last))
+      {
+         if (cmp(*right, *left))
+         {
+            *dest++ = std::move(*right++);
+            leftWins = 0;
+
+            if (++rightWins >= kMinGallop)
+            {
+               Iter runEnd = gallop_left(right, last,
+                                 [&](const auto& x){return cmp(x, *left);});
+               dest = std::move(right, runEnd, dest);
+               right = runEnd;
+               rightWins = 0;
+            }
+         }
+         else
+         {
+            *dest++ = std::move(*left++);
+            rightWins = 0;
+
+            if (++leftWins >= kMinGallop)
+            {
+               auto runEnd = gallop_left(left, leftEnd,
+                                 [&](const auto& x){return !cmp(*right, x);});
+               dest = std::move(left, runEnd, dest);
+               left = runEnd;
+               leftWins = 0;
+            }
+         }
+      }
+
+      // the rest of the right run is already in place
+      std::move(left, leftEnd, dest);
+   }
+
+   // Same as merge_lo, when the right run is shorter; merges from the end.
+   template<class Iter, class Compare, class Buffer>
+   void merge_hi(Iter first, Iter mid, Iter last, Compare& cmp, Buffer& buffer)
+   {
+      buffer.assign(std::make_move_iterator(mid), std::make_move_iterator(last));
+
+      auto rightBegin = buffer.begin();
+      auto right = buffer.end();
+      Iter left = mid;
+      Iter dest = last;
+      std::ptrdiff_t leftWins = 0, rightWins = 0;
+
+      while ((left != first) && (right != rightBegin))
+      {
+         if (cmp(*(right - 1), *(left - 1)))
+         {
+            *--dest = std::move(*--left);
+            rightWins = 0;
+
+            if (++leftWins >= kMinGallop)
+            {
+               Iter runBegin = gallop_right(first, left,
+                                 [&](const auto& x){return !cmp(*(right - 1), x);});
+               dest = std::move_backward(runBegin, left, dest);
+               left = runBegin;
+               leftWins = 0;
+            }
+         }
+         else
+         {
+            *--dest = std::move(*--right);
+            leftWins = 0;
+
+            if (++rightWins >= kMinGallop)
+            {
+               auto runBegin = gallop_right(rightBegin, right,
+                                 [&](const auto& x){return cmp(x, *(left - 1));});
+               dest = std::move_backward(runBegin, right, dest);
+               right = runBegin;
+               rightWins = 0;
+            }
+         }
+      }
+
+      // the rest of the left run is already in place
+      std::move_backward(rightBegin, right, dest);
+   }
+
+   // Stable merge of adjacent sorted runs [first, mid) and [mid, last).
+   template<class Iter, class Compare, class Buffer>
+   void merge_runs(Iter first, Iter mid, Iter last, Compare& cmp, Buffer& buffer)
+   {
+      // Elements of the left run that do not exceed the first element
+      // of the right run are already in place, and so are elements of
+      // the right run that are not less than the last element of the left run.
+      first = gallop_left(first, mid, [&](const auto& x){return !cmp(*mid, x);});
+      if (first == mid) return;
+
+      last = gallop_right(mid, last, [&](const auto& x){return cmp(x, *(mid - 1));});
+
+      if (mid - first <= last - mid)
+      {
+         merge_lo(first, mid, last, cmp, buffer);
+      }
+      else
+      {
+         merge_hi(first, mid, last, cmp, buffer);
+      }
+   }
+
+   // The "power" of the boundary between adjacent runs [s1, s1 + n1) and
+   // [s1 + n1, s1 + n1 + n2) in an array of size n (Munro & Wild, 2018):
+   // the depth of the boundary in a perfectly balanced merge tree.
+   inline int node_power(std::ptrdiff_t s1, std::ptrdiff_t n1, std::ptrdiff_t n2, std::ptrdiff_t n)
+   {
+      std::ptrdiff_t a = 2 * s1 + n1;   // 2 * midpoint of the first run
+      std::ptrdiff_t b = a + n1 + n2;   // 2 * midpoint of the second run
+      int power = 0;
+
+      while (true)
+      {
+         power++;
+
+         if (a >= n)
+         {
+            a -= n;
+            b -= n;
+         }
+         else if (b >= n)
+         {
+            break;
+         }
+
+         a = 2 * a;
+         b = 2 * b;
+      }
+
+      return power;
+   }
+
+   // Stable natural merge sort with the powersort merge policy.
+   template<class Iter, class Compare, class Buffer>
+   void powersort(Iter first, Iter last, Compare& cmp, Buffer& buffer)
+   {
+      struct Run
+      {
+         std::ptrdiff_t begin;
+         std::ptrdiff_t length;
+         int power;   // power of the boundary with the previous run
+      };
+
+      std::ptrdiff_t n = last - first;
+      std::vector<Run> stack;
+
+      auto mergeTop = [&]()
+      {
+         Run right = stack.back();
+         stack.pop_back();
+         Run& left = stack.back();
+
+         merge_runs(first + left.begin, first + right.begin,
+                    first + right.begin + right.length, cmp, buffer);
+         left.length += right.length;
+      };
+
+      for (std::ptrdiff_t begin = 0; begin < n; )
+      {
+         Iter runEnd = find_run(first + begin, last, cmp, true);
+         std::ptrdiff_t length = runEnd - (first + begin);
+
+         if (length < kMinRun)
+         {
+            std::ptrdiff_t extended = std::min(kMinRun, n - begin);
+            insertion_sort(first + begin, runEnd, first + begin + extended, cmp);
+            length = extended;
+         }
+
+         int power = 0;
+         if (!stack.empty())
+         {
+            power = node_power(stack.back().begin, stack.back().length, length, n);
+
+            while ((stack.size() > 1) && (stack.back().power > power))
+            {
+               mergeTop();
+            }
+         }
+
+         stack.push_back({begin, length, power});
+         begin += length;
+      }
+
+      while (stack.size() > 1)
+      {
+         mergeTop();
+      }
+   }
+}
+
+// Function **adaptive_sort** is a run-aware sort for data that is
+// sorted or nearly sorted, e.g., jobs appended in roughly chronological
+// order. It splits the data into natural runs (non-decreasing or strictly
+// decreasing sequences) and merges them as TimSort does, using the
+// "powersort" merge policy. Merges skip the parts of the runs that are
+// already in place and gallop when one run keeps winning, so presorted
+// data is sorted in O(n) time.
+//
+// Data that looks random is passed to std::sort. Hence, like std::sort,
+// adaptive_sort is not guaranteed to be stable.
+//
+// The merge buffer can be passed by the caller and reused across calls.
+// Examples:
+//   alg::adaptive_sort(jobs, order_by(&Job::finish));
+//
+//   std::vector<Job> buffer;
+//   for (auto& batch : batches)
+//      alg::adaptive_sort(batch.begin(), batch.end(), cmp, buffer);
+template<class Iter, class Compare>
+void adaptive_sort(Iter begin, Iter end, Compare cmp,
+                   std::vector<typename std::iterator_traits<Iter>::value_type>& buffer)
+{
+   if (detail::has_few_runs(begin, end, cmp))
+   {
+      detail::powersort(begin, end, cmp, buffer);
+   }
+   else
+   {
+      std::sort(begin, end, cmp);
+   }
+}
+
+template<class Iter, class Compare>
+void adaptive_sort(Iter begin, Iter end, Compare cmp)
+{
+   std::vector<typename std::iterator_traits<Iter>::value_type> buffer;
+   adaptive_sort(begin, end, cmp, buffer);
+}
+
+template<class T, class Compare>
+void adaptive_sort(T& data, Compare cmp)
+{
+   adaptive_sort(data.begin(), data.end(), cmp);
+}
+
 // Helper class **order_by** for sorting data by a field.
 // Examples: 
 //   sort (jobs, order_by(&Job::finish));
@@ -64,31 +432,26 @@ private:
 //   // sort intervals by their start time
 //   alg::sort_by<&Job::start>(intervals);
 // There is almost no run-time overhead associated with using this function.
+// It uses adaptive_sort, so sorted and nearly sorted data is sorted in
+// (almost) linear time.
 
-template<auto Field, class T>
-void sort_by(T& data, bool bAscending = true)
+template<auto Field, class Iter>
+void sort_by(Iter begin, Iter end, bool bAscending = true)
 {  
    if (bAscending)
    {
-      alg::sort(data, [](auto a, auto b){return (a.*Field < b.*Field);});
+      alg::adaptive_sort(begin, end, [](const auto& a, const auto& b){return (a.*Field < b.*Field);});
    }
    else
    {
-      alg::sort(data, [](auto a, auto b){return (a.*Field > b.*Field);});
+      alg::adaptive_sort(begin, end, [](const auto& a, const auto& b){return (a.*Field > b.*Field);});
    }
 }
 
-template<auto Field, class Iter>
-void sort_by(Iter begin, Iter end, bool bAscending = true)
+template<auto Field, class T>
+void sort_by(T& data, bool bAscending = true)
 {  
-   if (bAscending)
-   {
-      std::sort(begin, end, [](auto a, auto b){return (a.*Field < b.*Field);});
-   }
-   else
-   {
-      std::sort(begin, end, [](auto a, auto b){return (a.*Field > b.*Field);});
-   }
+   alg::sort_by<Field>(data.begin(), data.end(), bAscending);
 }
 
 // Helper class for sorting data by an expression.
@@ -128,6 +491,530 @@ private:
    bool bAscending_;
 };
 
+namespace detail
+{
+   // Hints the CPU to load the cache line containing **p**.
+   inline void prefetch(const void* p)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(p);
+#else
+      (void) p;
+#endif
+   }
+
+   // A search in the Eytzinger layout leaves the tree at node k,
+   // after turning right r times and then left once, where r is the
+   // number of trailing ones of k. The answer is the node where that
+   // left turn happened.
+   inline size_t eytzinger_answer(size_t k)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+#else
+      while (k & 1) k >>= 1;
+      return k >> 1;
+#endif
+   }
+}
+
+// Class **search_index** is a static search structure for sorted keys.
+// The keys are stored in the Eytzinger (BFS) order: the children of node
+// k are nodes 2k and 2k + 1. The first levels of the tree stay in the
+// cache, the nodes four levels below the current one share a cache line
+// (for 4-byte keys) and are prefetched, and every step is branchless.
+// This is usually several times faster than std::lower_bound on large arrays.
+//
+// lower_bound and upper_bound return positions in the original sorted
+// data, just like std::lower_bound(...) - data.begin(). The batched
+// versions interleave many searches to hide memory latency.
+//
+// Use function **search_index_by** to build an index over a field.
+// Examples:
+//   // jobs are sorted by finish time
+//   auto index = alg::search_index_by<&Job::finish>(jobs);
+//   // the first job that finishes at or after time t
+//   size_t i = index.lower_bound(t);
+//   // the number of jobs that finish at or before each time in **times**
+//   std::vector<size_t> counts;
+//   index.upper_bound(times, counts);
+template<class Key>
+class search_index
+{
+public:
+   search_index() : keys(1), ranks(1, 0), count(0), height(0){}
+
+   // Builds the index over projections of [begin, end), which must be
+   // sorted in increasing order.
+   template<class Iter, class Projection>
+   search_index(Iter begin, Iter end, Projection proj)
+   {
+      count = end - begin;
+      keys.resize(count + 1);
+      ranks.resize(count + 1);
+      ranks[0] = count;   // not found
+
+      height = 0;
+      while ((size_t(1) << height) <= count) height++;
+
+      build(begin, proj, 1, 0);
+   }
+
+   size_t size() const
+   {
+      return count;
+   }
+
+   // the position of the first key that is not less than x
+   size_t lower_bound(const Key& x) const
+   {
+      return search<false>(x);
+   }
+
+   // the position of the first key that is greater than x
+   size_t upper_bound(const Key& x) const
+   {
+      return search<true>(x);
+   }
+
+   void lower_bound(const std::vector<Key>& queries, std::vector<size_t>& results) const
+   {
+      search<false>(queries, results);
+   }
+
+   void upper_bound(const std::vector<Key>& queries, std::vector<size_t>& results) const
+   {
+      search<true>(queries, results);
+   }
+
+private:
+   // node k + kPrefetchStride * k is four levels below node k
+   static constexpr size_t kPrefetchStride = 16;
+
+   // the number of searches interleaved by batched queries
+   static constexpr size_t kBatchSize = 16;
+
+   // in-order traversal of the tree assigns sorted keys to nodes
+   template<class Iter, class Projection>
+   size_t build(Iter begin, Projection& proj, size_t k, size_t i)
+   {
+      if (k <= count)
+      {
+         i = build(begin, proj, 2 * k, i);
+         keys[k] = proj(*(begin + i));
+         ranks[k] = i++;
+         i = build(begin, proj, 2 * k + 1, i);
+      }
+
+      return i;
+   }
+
+   // one step down the tree: 0 - go left, 1 - go right
+   template<bool bUpper>
+   static size_t turn(const Key& x, const Key& key)
+   {
+      return bUpper ? !(x < key) : (key < x);
+   }
+
+   template<bool bUpper>
+   size_t search(const Key& x) const
+   {
+      const Key* t = keys.data();
+      size_t k = 1;
+
+      while (k <= count)
+      {
+         detail::prefetch(t + std::min(k * kPrefetchStride, count));
+         k = 2 * k + turn<bUpper>(x, t[k]);
+      }
+
+      return ranks[detail::eytzinger_answer(k)];
+   }
+
+   template<bool bUpper>
+   void search(const std::vector<Key>& queries, std::vector<size_t>& results) const
+   {
+      const Key* t = keys.data();
+      size_t nQueries = queries.size();
+      results.resize(nQueries);
+
+      for (size_t first = 0; first < nQueries; first += kBatchSize)
+      {
+         size_t batch = std::min(kBatchSize, nQueries - first);
+         const Key* q = queries.data() + first;
+         size_t k[kBatchSize];
+         std::fill(k, k + batch, 1);
+
+         // all searches go down the tree level by level, so that
+         // their memory accesses overlap
+         for (size_t level = 0; level < height; level++)
+         {
+            for (size_t j = 0; j < batch; j++)
+            {
+               if (k[j] <= count)
+               {
+                  detail::prefetch(t + std::min(k[j] * kPrefetchStride, count));
+                  k[j] = 2 * k[j] + turn<bUpper>(q[j], t[k[j]]);
+               }
+            }
+         }
+
+         for (size_t j = 0; j < batch; j++)
+         {
+            results[first + j] = ranks[detail::eytzinger_answer(k[j])];
+         }
+      }
+   }
+
+private:
+   std::vector<Key> keys;     // keys[1..count] in the Eytzinger order
+   std::vector<size_t> ranks; // ranks[k] is the position of keys[k] in the sorted data
+   size_t count;
+   size_t height;
+};
+
+// Function **search_index_by** builds a search_index over a field.
+// The data must be sorted by this field in increasing order.
+// Example:
+//   alg::sort_by<&Job::finish>(jobs);
+//   auto index = alg::search_index_by<&Job::finish>(jobs);
+template<auto Field, class T>
+auto search_index_by(const T& data)
+{
+   using Key = std::decay_t<decltype(std::declval<const typename T::value_type&>().*Field)>;
+   return search_index<Key>(data.begin(), data.end(),
+                            [](const auto& record){return record.*Field;});
+}
+
+namespace detail
+{
+   // Moves the keys that are less than **pivot** (not greater, if bOrEqual
+   // is set) to the front of [lo, hi), along with their indices.
+   // Returns the end of the moved part.
+   template<class Key>
+   size_t partition_columns(Key* keys, std::uint32_t* idx, size_t lo, size_t hi,
+                            Key pivot, bool bOrEqual)
+   {
+      size_t mid = lo;
+
+      // branchless Lomuto partition
+      for (size_t i = lo; i < hi; i++)
+      {
+         bool bLeft = bOrEqual ? !(pivot < keys[i]) : (keys[i] < pivot);
+         std::swap(keys[mid], keys[i]);
+         std::swap(idx[mid], idx[i]);
+         mid += bLeft;
+      }
+
+      return mid;
+   }
+
+#if SIMD_X86
+   // compress_lut()[mask] is a permutation for _mm256_permutevar8x32_epi32,
+   // which moves the lanes selected by **mask** to the front.
+   struct compress_table
+   {
+      alignas(32) int perm[256][8];
+   };
+
+   inline const compress_table& compress_lut()
+   {
+      static const compress_table lut = []()
+      {
+         compress_table table;
+
+         for (int mask = 0; mask < 256; mask++)
+         {
+            int pos = 0;
+
+            for (int lane = 0; lane < 8; lane++)
+            {
+               if (mask & (1 << lane)) table.perm[mask][pos++] = lane;
+            }
+
+            for (int lane = 0; lane < 8; lane++)
+            {
+               if (!(mask & (1 << lane))) table.perm[mask][pos++] = lane;
+            }
+         }
+
+         return table;
+      }();
+
+      return lut;
+   }
+
+   __attribute__((target("avx2")))
+   inline __m256i load_block(const void* p)
+   {
+      return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+   }
+
+   __attribute__((target("avx2")))
+   inline void store_block(void* p, __m256i v)
+   {
+      _mm256_storeu_si256(static_cast<__m256i*>(p), v);
+   }
+
+   // AVX2 version: partitions eight keys at a time, in place.
+   // Blocks are read from both ends of the range, always from the end
+   // with less free space, so the compress-stores to the left and to the
+   // right never overwrite unread keys. The first and the last blocks
+   // are saved in advance to make the initial free space.
+   // Compiled with a target attribute; partition_columns calls it if
+   // Simd::Dispatch() selected AVX2 or better.
+   __attribute__((target("avx2")))
+   inline size_t partition_columns_avx2(int* keys, std::uint32_t* idx, size_t lo, size_t hi,
+                                        int pivot, bool bOrEqual)
+   {
+      if (hi - lo < 16) return partition_columns<int>(keys, idx, lo, hi, pivot, bOrEqual);
+
+      const compress_table& lut = compress_lut();
+      const __m256i vPivot = _mm256_set1_epi32(pivot);
+
+
+      // keys and indices that are not yet partitioned
+      alignas(32) int restKeys[24];
+      alignas(32) std::uint32_t restIdx[24];
+      store_block(restKeys, load_block(keys + lo));
+      store_block(restIdx, load_block(idx + lo));
+      store_block(restKeys + 8, load_block(keys + hi - 8));
+      store_block(restIdx + 8, load_block(idx + hi - 8));
+
+      size_t left = lo, right = hi;               // write positions
+      size_t readLeft = lo + 8, readRight = hi - 8;
+
+      while (readRight - readLeft >= 8)
+      {
+         size_t pos;
+         if (readLeft - left <= right - readRight)
+         {
+            pos = readLeft;
+            readLeft += 8;
+         }
+         else
+         {
+            readRight -= 8;
+            pos = readRight;
+         }
+
+         __m256i vKeys = load_block(keys + pos);
+         __m256i vIdx = load_block(idx + pos);
+
+         int mask = bOrEqual ?
+            (~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vKeys, vPivot))) & 0xff) :
+            _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vPivot, vKeys)));
+         size_t nLeft = __builtin_popcount(static_cast<unsigned>(mask));
+
+         // the permutation puts the left lanes first and the right lanes last
+         __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(lut.perm[mask]));
+         vKeys = _mm256_permutevar8x32_epi32(vKeys, perm);
+         vIdx = _mm256_permutevar8x32_epi32(vIdx, perm);
+
+         store_block(keys + left, vKeys);
+         store_block(idx + left, vIdx);
+         store_block(keys + right - 8, vKeys);
+         store_block(idx + right - 8, vIdx);
+
+         left += nLeft;
+         right -= 8 - nLeft;
+      }
+
+      size_t nRest = 16;
+      for (size_t i = readLeft; i < readRight; i++, nRest++)
+      {
+         restKeys[nRest] = keys[i];
+         restIdx[nRest] = idx[i];
+      }
+
+      for (size_t i = 0; i < nRest; i++)
+      {
+         bool bLeft = bOrEqual ? (restKeys[i] <= pivot) : (restKeys[i] < pivot);
+         size_t pos = bLeft ? left++ : --right;
+         keys[pos] = restKeys[i];
+         idx[pos] = restIdx[i];
+      }
+
+      return left;
+   }
+#endif
+
+   inline size_t partition_columns(int* keys, std::uint32_t* idx, size_t lo, size_t hi,
+                                   int pivot, bool bOrEqual)
+   {
+#if SIMD_X86
+      if (Simd::Dispatch().level >= Simd::Level::AVX2)
+      {
+         return partition_columns_avx2(keys, idx, lo, hi, pivot, bOrEqual);
+      }
+#endif
+      return partition_columns<int>(keys, idx, lo, hi, pivot, bOrEqual);
+   }
+
+   // Quickselect over a column of keys and a column of record indices:
+   // moves the key of rank **nth** to position nth, smaller keys before
+   // it and larger keys after it. Falls back to std::nth_element if
+   // the pivots are bad too many times.
+   template<class Key>
+   void select_columns(std::vector<Key>& keys, std::vector<std::uint32_t>& idx, size_t nth)
+   {
+      size_t lo = 0, hi = keys.size();
+
+      int budget = 8;
+      for (size_t n = hi; n > 1; n /= 2) budget += 2;
+
+      while (hi - lo > 1)
+      {
+         if (budget-- == 0)
+         {
+            std::vector<std::pair<Key, std::uint32_t>> pairs;
+            pairs.reserve(hi - lo);
+            for (size_t i = lo; i < hi; i++) pairs.emplace_back(keys[i], idx[i]);
+
+            std::nth_element(pairs.begin(), pairs.begin() + (nth - lo), pairs.end(),
+                     [](const auto& a, const auto& b){return a.first < b.first;});
+
+            for (size_t i = lo; i < hi; i++)
+            {
+               keys[i] = pairs[i - lo].first;
+               idx[i] = pairs[i - lo].second;
+            }
+
+            return;
+         }
+
+         // median of three
+         const Key& a = keys[lo];
+         const Key& b = keys[lo + (hi - lo) / 2];
+         const Key& c = keys[hi - 1];
+         Key pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+         size_t mid = partition_columns(keys.data(), idx.data(), lo, hi, pivot, false);
+
+         if (nth < mid)
+         {
+            hi = mid;
+         }
+         else if (mid > lo)
+         {
+            lo = mid;
+         }
+         else
+         {
+            // the pivot is the minimum: split off the keys equal to it
+            mid = partition_columns(keys.data(), idx.data(), lo, hi, pivot, true);
+            if (nth < mid) return;
+            lo = mid;
+         }
+      }
+   }
+
+   // Copies the field of each record to **keys** and numbers the records.
+   template<auto Field, class T, class Key>
+   void extract_column(const T& data, std::vector<Key>& keys, std::vector<std::uint32_t>& idx)
+   {
+      keys.clear();
+      idx.clear();
+      keys.reserve(data.size());
+      idx.reserve(data.size());
+
+      std::uint32_t i = 0;
+      for (const auto& record : data)
+      {
+         keys.push_back(record.*Field);
+         idx.push_back(i++);
+      }
+   }
+
+   template<auto Field, class T>
+   using field_type = std::decay_t<decltype(std::declval<const typename T::value_type&>().*Field)>;
+}
+
+// Functions **nth_by** and **top_k_by** select records by a field in
+// linear expected time, without sorting all the data.
+//
+// nth_by works like std::nth_element: it rearranges **data** so that
+// the record at position **nth** is the one that would be there if the
+// data were sorted by the field; the records before it are not greater
+// (not less, if bAscending is false) and the records after it are not less.
+//
+// top_k_by returns the k records with the smallest (or largest) values of
+// the field, sorted by the field if bSorted is true.
+//
+// Both functions partition a copy of the field along with record
+// indices and move every record only once. On CPUs with AVX2 (chosen at
+// run time by Simd::Dispatch()), int fields are partitioned eight at a time.
+//
+// Examples:
+//   // the 10 jobs that finish first, in order of their finish times
+//   auto first = alg::top_k_by<&Job::finish>(jobs, 10);
+//   // the 10 heaviest items, in any order
+//   auto heaviest = alg::top_k_by<&Item::weight>(items, 10, false, false);
+//   // the median job
+//   alg::nth_by<&Job::finish>(jobs, jobs.size() / 2);
+template<auto Field, class T>
+void nth_by(T& data, size_t nth, bool bAscending = true)
+{
+   size_t n = data.size();
+   if (nth >= n) return;
+
+   std::vector<detail::field_type<Field, T>> keys;
+   std::vector<std::uint32_t> idx;
+   detail::extract_column<Field>(data, keys, idx);
+
+   // the descending order is the ascending one reversed
+   detail::select_columns(keys, idx, bAscending ? nth : (n - 1 - nth));
+   if (!bAscending) std::reverse(idx.begin(), idx.end());
+
+   std::vector<typename T::value_type> result;
+   result.reserve(n);
+   for (std::uint32_t i : idx) result.push_back(std::move(data[i]));
+
+   std::move(result.begin(), result.end(), data.begin());
+}
+
+template<auto Field, class T>
+auto top_k_by(const T& data, size_t k, bool bAscending = true, bool bSorted = true)
+{
+   using Key = detail::field_type<Field, T>;
+
+   size_t n = data.size();
+   k = std::min(k, n);
+
+   std::vector<typename T::value_type> result;
+   if (k == 0) return result;
+
+   std::vector<Key> keys;
+   std::vector<std::uint32_t> idx;
+   detail::extract_column<Field>(data, keys, idx);
+
+   // the top k records occupy [first, first + k) after the selection
+   size_t first = bAscending ? 0 : (n - k);
+   detail::select_columns(keys, idx, bAscending ? (k - 1) : first);
+
+   if (bSorted)
+   {
+      std::vector<std::pair<Key, std::uint32_t>> pairs;
+      pairs.reserve(k);
+      for (size_t i = first; i < first + k; i++) pairs.emplace_back(keys[i], idx[i]);
+
+      // ties are broken by the position in the data
+      std::sort(pairs.begin(), pairs.end(), [bAscending](const auto& a, const auto& b)
+      {
+         if (a.first < b.first) return bAscending;
+         if (b.first < a.first) return !bAscending;
+         return a.second < b.second;
+      });
+
+      for (size_t i = 0; i < k; i++) idx[first + i] = pairs[i].second;
+   }
+
+   result.reserve(k);
+   for (size_t i = first; i < first + k; i++) result.push_back(data[idx[i]]);
+
+   return result;
+}
+
 // Function **create_table** is used for creating 
 // multidimensional tables/arrays with default 
 // value **value**. This function is helpful, when you 
@@ -155,6 +1042,1426 @@ auto create_table(int size, Targs... args)
    return table;
 }
 
+namespace detail
+{
+   template<class T, std::size_t... Dims>
+   struct nested_array
+   {
+      typedef T type;
+   };
+
+   template<class T, std::size_t D, std::size_t... Dims>
+   struct nested_array<T, D, Dims...>
+   {
+      typedef std::array<typename nested_array<T, Dims...>::type, D> type;
+   };
+
+   constexpr std::size_t next_power_of_two(std::size_t k)
+   {
+      std::size_t p = 1;
+      while (p < k) p *= 2;
+      return p;
+   }
+
+   template<class T>
+   void fill_cells(T& cell, const T& value)
+   {
+      cell = value;
+   }
+
+   template<class A, std::size_t N, class T>
+   void fill_cells(std::array<A, N>& slice, const T& value)
+   {
+      for (auto& item : slice) fill_cells(item, value);
+   }
+}
+
+// Class **rolling_table** is a DP table for recurrences that look back
+// at most K - 1 steps: table[i] depends only on table[i - 1], ...,
+// table[i - K + 1]. It keeps only the last K slices (rounded up to a
+// power of two, so that table[i] is slices[i & mask]) and may be indexed
+// by i = 0, 1, 2, ... as if it were the whole table. Slices written more
+// than K steps ago are overwritten.
+//
+// **Dims** are the sizes of the other dimensions; the slices are stored
+// contiguously. If these sizes are known only at run time, use
+// a vector as the entry type.
+//
+// Examples:
+//   // optValues[i] depends on optValues[i - 1] and optValues[i - 2]
+//   alg::rolling_table<int, 3> optValues(0);
+//   optValues[i + 1] = std::max(optValues[i], optValues[i - 1] + weights[i + 1]);
+//
+//   // table[i][j] depends on table[i - 1][...]; j < 64
+//   alg::rolling_table<int, 2, 64> table(-1);
+//
+//   // the same, but j < m
+//   alg::rolling_table<std::vector<int>, 2> table(std::vector<int>(m, -1));
+template<class T, std::size_t K, std::size_t... Dims>
+class rolling_table
+{
+   static_assert(K > 0, "The window must contain at least one slice.");
+
+public:
+   typedef typename detail::nested_array<T, Dims...>::type slice_type;
+
+public:
+   rolling_table() : slices(kCapacity){}
+
+   explicit rolling_table(const T& value) : slices(kCapacity)
+   {
+      fill(value);
+   }
+
+   slice_type& operator[](std::size_t i)
+   {
+      return slices[i & kMask];
+   }
+
+   const slice_type& operator[](std::size_t i) const
+   {
+      return slices[i & kMask];
+   }
+
+   void fill(const T& value)
+   {
+      for (auto& slice : slices) detail::fill_cells(slice, value);
+   }
+
+   // the number of slices that are guaranteed to be kept
+   static constexpr std::size_t window()
+   {
+      return K;
+   }
+
+private:
+   static constexpr std::size_t kCapacity = detail::next_power_of_two(K);
+   static constexpr std::size_t kMask = kCapacity - 1;
+
+   std::vector<slice_type> slices;
+};
+
+// Class **bit_row** is a row of a boolean DP table that packs 64 states
+// into a word. Transitions are applied to whole words at once: OR and
+// AND of rows, and "shift-or" (row |= src << shift), which is the typical
+// transition of knapsack-like DPs. The loops are simple enough for the
+// compiler to vectorize (with -O3), so one instruction updates 64 to
+// 512 states, depending on the instruction set.
+//
+// Use function **create_bit_table** in place of create_table(..., false).
+//
+// Example (subset sum):
+//   // reachable[i][s] is true if some subset of the first i items weighs s
+//   auto reachable = alg::create_bit_table(n + 1, target + 1, false);
+//   reachable[0].set(0);
+//   for (size_t i = 0; i < n; i++)
+//   {
+//      reachable[i + 1] = reachable[i];
+//      reachable[i + 1].or_shifted(reachable[i], weights[i]);
+//   }
+//   bool bFeasible = reachable[n][target];
+class bit_row
+{
+public:
+   explicit bit_row(std::size_t size = 0, bool value = false) :
+      nBits(size), words((size + 63) / 64, value ? ~std::uint64_t(0) : 0)
+   {
+      clear_tail();
+   }
+
+   std::size_t size() const
+   {
+      return nBits;
+   }
+
+   bool operator[](std::size_t i) const
+   {
+      return test(i);
+   }
+
+   bool test(std::size_t i) const
+   {
+      return (words[i / 64] >> (i % 64)) & 1;
+   }
+
+   void set(std::size_t i, bool value = true)
+   {
+      std::uint64_t bit = std::uint64_t(1) << (i % 64);
+      words[i / 64] = value ? (words[i / 64] | bit) : (words[i / 64] & ~bit);
+   }
+
+   void reset(std::size_t i)
+   {
+      set(i, false);
+   }
+
+   void fill(bool value)
+   {
+      std::fill(words.begin(), words.end(), value ? ~std::uint64_t(0) : 0);
+      clear_tail();
+   }
+
+   // the number of true states
+   std::size_t count() const
+   {
+      std::size_t result = 0;
+      for (std::uint64_t w : words) result += std::bitset<64>(w).count();
+      return result;
+   }
+
+   bool any() const
+   {
+      for (std::uint64_t w : words)
+      {
+         if (w != 0) return true;
+      }
+
+      return false;
+   }
+
+   // the largest i such that row[i] is true; size() if there is none
+   std::size_t find_last() const
+   {
+      for (std::size_t k = words.size(); k-- > 0; )
+      {
+         for (std::size_t b = 64; (words[k] != 0) && (b-- > 0); )
+         {
+            if ((words[k] >> b) & 1) return 64 * k + b;
+         }
+      }
+
+      return nBits;
+   }
+
+   bit_row& operator|=(const bit_row& other)
+   {
+      std::size_t n = std::min(words.size(), other.words.size());
+      for (std::size_t k = 0; k < n; k++) words[k] |= other.words[k];
+      clear_tail();
+      return *this;
+   }
+
+   bit_row& operator&=(const bit_row& other)
+   {
+      std::size_t n = std::min(words.size(), other.words.size());
+      for (std::size_t k = 0; k < n; k++) words[k] &= other.words[k];
+      std::fill(words.begin() + n, words.end(), 0);
+      return *this;
+   }
+
+   // row[i + shift] |= src[i] for all i; **shift** may be negative.
+   // Bits shifted out of the row are dropped; src may be this row.
+   void or_shifted(const bit_row& src, std::ptrdiff_t shift)
+   {
+      if (shift >= 0)
+      {
+         or_shifted_up(src, static_cast<std::size_t>(shift));
+      }
+      else
+      {
+         or_shifted_down(src, static_cast<std::size_t>(-shift));
+      }
+
+      clear_tail();
+   }
+
+   const std::vector<std::uint64_t>& data() const
+   {
+      return words;
+   }
+
+private:
+   // Both functions read only the words of src that they have not yet
+   // written to, so src may alias this row.
+   void or_shifted_up(const bit_row& src, std::size_t shift)
+   {
+      std::size_t ws = shift / 64, bs = shift % 64;
+      std::size_t nSrc = src.words.size();
+      if ((nSrc == 0) || (ws >= words.size())) return;
+
+      const std::uint64_t* s = src.words.data();
+      std::uint64_t* d = words.data();
+      std::size_t n = std::min(words.size(), nSrc + ws);
+
+      if (bs == 0)
+      {
+         for (std::size_t k = n; k-- > ws; ) d[k] |= s[k - ws];
+      }
+      else
+      {
+         // the high bits of the last word of src
+         if (nSrc + ws < words.size()) d[nSrc + ws] |= s[nSrc - 1] >> (64 - bs);
+
+         for (std::size_t k = n; k-- > ws + 1; )
+         {
+            d[k] |= (s[k - ws] << bs) | (s[k - ws - 1] >> (64 - bs));
+         }
+
+         d[ws] |= s[0] << bs;
+      }
+   }
+
+   void or_shifted_down(const bit_row& src, std::size_t shift)
+   {
+      std::size_t ws = shift / 64, bs = shift % 64;
+      if (ws >= src.words.size()) return;
+
+      std::size_t n = std::min(words.size(), src.words.size() - ws);
+      const std::uint64_t* s = src.words.data() + ws;
+      std::uint64_t* d = words.data();
+      std::size_t last = src.words.size() - ws - 1;   // the last word of s
+
+      if (bs == 0)
+      {
+         for (std::size_t k = 0; k < n; k++) d[k] |= s[k];
+      }
+      else
+      {
+         std::size_t m = std::min(n, last);
+         for (std::size_t k = 0; k < m; k++)
+         {
+            d[k] |= (s[k] >> bs) | (s[k + 1] << (64 - bs));
+         }
+
+         if (m < n) d[m] |= s[m] >> bs;
+      }
+   }
+
+   // keeps the bits beyond size() zero
+   void clear_tail()
+   {
+      if (nBits % 64 != 0)
+      {
+         words.back() &= (std::uint64_t(1) << (nBits % 64)) - 1;
+      }
+   }
+
+private:
+   std::size_t nBits;
+   std::vector<std::uint64_t> words;
+};
+
+// Function **create_bit_table** creates a boolean DP table of
+// size x cols states, with rows stored as bit_row.
+inline std::vector<bit_row> create_bit_table(std::size_t size, std::size_t cols, bool value)
+{
+   return std::vector<bit_row>(size, bit_row(cols, value));
+}
+
+template<class T, std::size_t D>
+class sparse_table;
+
+// Class **sparse_index** is returned by sparse_table::operator[] when
+// fewer than D indices are given; it packs the indices given so far.
+template<class T, std::size_t D, std::size_t Depth>
+class sparse_index
+{
+public:
+   sparse_index(sparse_table<T, D>& table, std::uint64_t key) : table(table), key(key){}
+
+   decltype(auto) operator[](std::uint64_t i)
+   {
+      return table.template subscript<Depth + 1>(key * table.sizes[Depth] + i);
+   }
+
+private:
+   sparse_table<T, D>& table;
+   std::uint64_t key;
+};
+
+// Class **sparse_table** is a D-dimensional DP table that stores only
+// the entries that were accessed. It is useful for top-down (memoized)
+// DP algorithms, whose state spaces are huge but visited sparsely.
+// Use function **create_sparse_table** to create it; its indexing
+// interface is the same as that of create_table: reading a missing entry
+// inserts it with the default value.
+//
+// The entries are kept in a flat open-addressing hash table keyed by
+// the packed indices. Slots are probed in groups of 16, comparing 16
+// control bytes (7 bits of the hash each) with one SSE2 instruction.
+//
+// If a memory limit is set, the table evicts the least recently used
+// entries to stay under it. Memoized values that are evicted are simply
+// recomputed.
+//
+// Remark: references to entries are invalidated by insertions.
+//
+// Example:
+//   auto dpTable = alg::create_sparse_table(n, capacity, notValue);
+//   dpTable.set_memory_limit(256 << 20);   // optional
+//   if (dpTable[k][c] != notValue) return dpTable[k][c];
+//   ...
+//   dpTable[k][c] = result;
+template<class T, std::size_t D>
+class sparse_table
+{
+   static_assert(D > 0, "A table must have at least one dimension.");
+
+   template<class, std::size_t, std::size_t> friend class sparse_index;
+
+public:
+   sparse_table(const std::array<std::uint64_t, D>& sizes, const T& value) :
+      sizes(sizes), defaultValue(value), maxEntries(0)
+   {
+      reset(kMinCapacity);
+   }
+
+   decltype(auto) operator[](std::uint64_t i)
+   {
+      return subscript<1>(i);
+   }
+
+   // Returns the entry or nullptr if it is not in the table.
+   // Does not insert the entry and does not change the LRU order.
+   template<class... Indices>
+   const T* find(Indices... index) const
+   {
+      static_assert(sizeof...(Indices) == D, "Wrong number of indices.");
+
+      std::uint64_t key = 0;
+      std::size_t d = 0;
+      ((key = key * sizes[d++] + static_cast<std::uint64_t>(index)), ...);
+
+      std::size_t slot = find_slot(key, hash(key));
+      return (slot == kNone) ? nullptr : &values[slot];
+   }
+
+   // the number of stored entries
+   std::size_t size() const
+   {
+      return count;
+   }
+
+   void clear()
+   {
+      reset((maxEntries == 0) ? kMinCapacity : ctrl.size());
+   }
+
+   // Limits the memory used by the table to about **bytes** bytes;
+   // 0 means no limit. Clears the table.
+   void set_memory_limit(std::size_t bytes)
+   {
+      if (bytes == 0)
+      {
+         maxEntries = 0;
+         reset(kMinCapacity);
+         return;
+      }
+
+      constexpr std::size_t slotSize = sizeof(std::uint8_t) + sizeof(std::uint64_t) +
+                                       sizeof(T) + 2 * sizeof(std::uint32_t);
+      std::size_t capacity = kMinCapacity;
+      while (2 * capacity * slotSize <= bytes) capacity *= 2;
+
+      // at most 7/16 of the slots are live, so that deleted slots do
+      // not trigger rehashing too often
+      maxEntries = capacity * 7 / 16;
+      reset(capacity);
+   }
+
+private:
+   static constexpr std::size_t kGroupSize = 16;
+   static constexpr std::size_t kMinCapacity = kGroupSize;
+   static constexpr std::size_t kNone = ~std::size_t(0);
+   static constexpr std::uint32_t kNoLink = ~std::uint32_t(0);
+
+   // control bytes: 0..127 - full slot (7 bits of the hash)
+   static constexpr std::uint8_t kEmpty = 0x80;
+   static constexpr std::uint8_t kDeleted = 0xFE;
+
+   template<std::size_t Depth>
+   decltype(auto) subscript(std::uint64_t key)
+   {
+      if constexpr (Depth == D)
+      {
+         return get(key);
+      }
+      else
+      {
+         return sparse_index<T, D, Depth>(*this, key);
+      }
+   }
+
+   static std::uint64_t hash(std::uint64_t key)
+   {
+      // splitmix64 finalizer
+      key += 0x9e3779b97f4a7c15ull;
+      key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+      key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+      return key ^ (key >> 31);
+   }
+
+   // bit i is set if control byte i of the group equals **h2**
+   static std::uint32_t match(const std::uint8_t* group, std::uint8_t h2)
+   {
+#if defined(__SSE2__)
+      __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(static_cast<char>(h2))));
+#else
+      std::uint32_t mask = 0;
+      for (std::size_t i = 0; i < kGroupSize; i++) mask |= std::uint32_t(group[i] == h2) << i;
+      return mask;
+#endif
+   }
+
+   // bit i is set if slot i of the group is empty or deleted
+   static std::uint32_t match_free(const std::uint8_t* group)
+   {
+#if defined(__SSE2__)
+      return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group)));
+#else
+      std::uint32_t mask = 0;
+      for (std::size_t i = 0; i < kGroupSize; i++) mask |= std::uint32_t(group[i] >> 7) << i;
+      return mask;
+#endif
+   }
+
+   static std::size_t lowest_bit(std::uint32_t mask)
+   {
+      std::size_t i = 0;
+      while (!(mask & 1))
+      {
+         mask >>= 1;
+         i++;
+      }
+
+      return i;
+   }
+
+   // Groups are probed in the order g, g + 1, g + 3, g + 6, ...,
+   // which visits every group, since the number of groups is a power of two.
+   // A probe stops at a group with an empty slot.
+   std::size_t find_slot(std::uint64_t key, std::uint64_t h) const
+   {
+      std::size_t groupMask = ctrl.size() / kGroupSize - 1;
+      std::size_t g = (h >> 7) & groupMask;
+      std::uint8_t h2 = h & 0x7f;
+
+      for (std::size_t step = 1; ; step++)
+      {
+         const std::uint8_t* group = ctrl.data() + g * kGroupSize;
+
+         for (std::uint32_t mask = match(group, h2); mask != 0; mask &= mask - 1)
+         {
+            std::size_t slot = g * kGroupSize + lowest_bit(mask);
+            if (keys[slot] == key) return slot;
+         }
+
+         if (match(group, kEmpty) != 0) return kNone;
+
+         g = (g + step) & groupMask;
+      }
+   }
+
+   std::size_t find_free_slot(std::uint64_t h) const
+   {
+      std::size_t groupMask = ctrl.size() / kGroupSize - 1;
+      std::size_t g = (h >> 7) & groupMask;
+
+      for (std::size_t step = 1; ; step++)
+      {
+         std::uint32_t mask = match_free(ctrl.data() + g * kGroupSize);
+         if (mask != 0) return g * kGroupSize + lowest_bit(mask);
+
+         g = (g + step) & groupMask;
+      }
+   }
+
+   T& get(std::uint64_t key)
+   {
+      std::uint64_t h = hash(key);
+      std::size_t slot = find_slot(key, h);
+
+      if (slot != kNone)
+      {
+         touch(slot);
+         return values[slot];
+      }
+
+      if ((maxEntries != 0) && (count >= maxEntries))
+      {
+         erase(tail);
+      }
+
+      if (8 * (count + tombstones + 1) > 7 * ctrl.size())
+      {
+         bool bGrow = (maxEntries == 0) && (16 * (count + 1) > 7 * ctrl.size());
+         rehash(bGrow ? 2 * ctrl.size() : ctrl.size());
+      }
+
+      slot = place(key, h, T(defaultValue));
+      return values[slot];
+   }
+
+   std::size_t place(std::uint64_t key, std::uint64_t h, T&& value)
+   {
+      std::size_t slot = find_free_slot(h);
+      if (ctrl[slot] == kDeleted) tombstones--;
+
+      ctrl[slot] = h & 0x7f;
+      keys[slot] = key;
+      values[slot] = std::move(value);
+      count++;
+      link_front(slot);
+
+      return slot;
+   }
+
+   void erase(std::size_t slot)
+   {
+      unlink(slot);
+
+      // If the group has an empty slot, no probe goes past it,
+      // so the slot can be marked empty rather than deleted.
+      const std::uint8_t* group = ctrl.data() + slot / kGroupSize * kGroupSize;
+      bool bEmpty = (match(group, kEmpty) != 0);
+
+      ctrl[slot] = bEmpty ? kEmpty : kDeleted;
+      if (!bEmpty) tombstones++;
+
+      values[slot] = T();
+      count--;
+   }
+
+   void reset(std::size_t capacity)
+   {
+      ctrl.assign(capacity, kEmpty);
+      keys.assign(capacity, 0);
+      values.assign(capacity, T());
+
+      prev.assign((maxEntries != 0) ? capacity : 0, kNoLink);
+      next.assign((maxEntries != 0) ? capacity : 0, kNoLink);
+      head = tail = kNoLink;
+
+      count = 0;
+      tombstones = 0;
+   }
+
+   void rehash(std::size_t capacity)
+   {
+      std::vector<std::uint8_t> oldCtrl(std::move(ctrl));
+      std::vector<std::uint64_t> oldKeys(std::move(keys));
+      std::vector<T> oldValues(std::move(values));
+      std::vector<std::uint32_t> oldPrev(std::move(prev));
+      std::uint32_t oldTail = tail;
+
+      reset(capacity);
+
+      if (maxEntries != 0)
+      {
+         // from the least to the most recently used, to keep the LRU order
+         for (std::uint32_t slot = oldTail; slot != kNoLink; slot = oldPrev[slot])
+         {
+            place(oldKeys[slot], hash(oldKeys[slot]), std::move(oldValues[slot]));
+         }
+      }
+      else
+      {
+         for (std::size_t slot = 0; slot < oldCtrl.size(); slot++)
+         {
+            if (oldCtrl[slot] < kEmpty)
+            {
+               place(oldKeys[slot], hash(oldKeys[slot]), std::move(oldValues[slot]));
+            }
+         }
+      }
+   }
+
+   // LRU list: head is the most recently used entry. It is kept only
+   // when the memory is limited.
+   void link_front(std::size_t slot)
+   {
+      if (maxEntries == 0) return;
+
+      prev[slot] = kNoLink;
+      next[slot] = head;
+      if (head != kNoLink) prev[head] = static_cast<std::uint32_t>(slot);
+      head = static_cast<std::uint32_t>(slot);
+      if (tail == kNoLink) tail = head;
+   }
+
+   void unlink(std::size_t slot)
+   {
+      if (maxEntries == 0) return;
+
+      if (prev[slot] != kNoLink) next[prev[slot]] = next[slot]; else head = next[slot];
+      if (next[slot] != kNoLink) prev[next[slot]] = prev[slot]; else tail = prev[slot];
+   }
+
+   void touch(std::size_t slot)
+   {
+      if ((maxEntries == 0) || (slot == head)) return;
+
+      unlink(slot);
+      link_front(slot);
+   }
+
+private:
+   std::array<std::uint64_t, D> sizes;
+   T defaultValue;
+
+   std::vector<std::uint8_t> ctrl;
+   std::vector<std::uint64_t> keys;
+   std::vector<T> values;
+
+   std::vector<std::uint32_t> prev;
+   std::vector<std::uint32_t> next;
+   std::uint32_t head;
+   std::uint32_t tail;
+
+   std::size_t count;
+   std::size_t tombstones;
+   std::size_t maxEntries;   // 0 - no limit
+};
+
+namespace detail
+{
+   template<class Tuple, std::size_t... I>
+   auto create_sparse_table(const Tuple& args, std::index_sequence<I...>)
+   {
+      constexpr std::size_t D = sizeof...(I);
+      typedef std::decay_t<std::tuple_element_t<D, Tuple>> T;
+
+      std::array<std::uint64_t, D> sizes = {static_cast<std::uint64_t>(std::get<I>(args))...};
+      return sparse_table<T, D>(sizes, std::get<D>(args));
+   }
+}
+
+// Function **create_sparse_table** creates a sparse_table. Its
+// arguments are the same as those of create_table: the sizes of the
+// dimensions followed by the default value. The product of the sizes
+// must fit into 64 bits.
+//
+// Example:
+//   // a 10^6 x 10^6 table with default value -1
+//   auto table = alg::create_sparse_table(1000000, 1000000, -1);
+template<typename... Targs>
+auto create_sparse_table(Targs... args)
+{
+   static_assert(sizeof...(Targs) >= 2, "Specify the sizes and the default value.");
+   return detail::create_sparse_table(std::make_tuple(args...),
+                                      std::make_index_sequence<sizeof...(Targs) - 1>());
+}
+
+// Class **thread_pool** keeps a set of worker threads for data-parallel
+// loops. parallel_for(count, task) calls task(i) for every i in
+// [0, count) on the workers and on the calling thread, and returns when
+// all calls are finished.
+//
+// set_thread_start_hook(hook) makes the workers of the pools created
+// afterwards call hook() when they start, e.g., to register the threads
+// with a profiler.
+//
+// Example:
+//   alg::thread_pool pool;
+//   pool.parallel_for(problems.size(), [&](size_t i){ Solve(problems[i]); });
+class thread_pool
+{
+public:
+   // **nThreads** is the total number of threads, including the calling one
+   explicit thread_pool(std::size_t nThreads = std::thread::hardware_concurrency()) :
+      pTask(nullptr), taskCount(0), nextTask(0), busy(0), generation(0), bStop(false)
+   {
+      for (std::size_t i = 1; i < nThreads; i++)
+      {
+         threads.emplace_back([this](){worker();});
+      }
+   }
+
+   ~thread_pool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         bStop = true;
+      }
+
+      start.notify_all();
+      for (std::thread& t : threads) t.join();
+   }
+
+   thread_pool(const thread_pool&) = delete;
+   thread_pool& operator=(const thread_pool&) = delete;
+
+   std::size_t size() const
+   {
+      return threads.size() + 1;
+   }
+
+   static void set_thread_start_hook(void (*hook)())
+   {
+      thread_start_hook().store(hook);
+   }
+
+   void parallel_for(std::size_t count, const std::function<void(std::size_t)>& task)
+   {
+      if (threads.empty() || (count <= 1))
+      {
+         for (std::size_t i = 0; i < count; i++) task(i);
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         pTask = &task;
+         taskCount = count;
+         nextTask = 0;
+         busy = threads.size();
+         generation++;
+      }
+
+      start.notify_all();
+      run_tasks(task, count);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [this](){return busy == 0;});
+   }
+
+private:
+   static std::atomic<void (*)()>& thread_start_hook()
+   {
+      static std::atomic<void (*)()> hook{nullptr};
+      return hook;
+   }
+
+   void run_tasks(const std::function<void(std::size_t)>& task, std::size_t count)
+   {
+      for (std::size_t i = nextTask++; i < count; i = nextTask++)
+      {
+         task(i);
+      }
+   }
+
+   void worker()
+   {
+      void (*hook)() = thread_start_hook().load();
+      if (hook != nullptr) hook();
+
+      std::uint64_t seen = 0;
+
+      while (true)
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         start.wait(lock, [&](){return bStop || (generation != seen);});
+         if (bStop) return;
+
+         seen = generation;
+         const std::function<void(std::size_t)>& task = *pTask;
+         std::size_t count = taskCount;
+         lock.unlock();
+
+         run_tasks(task, count);
+
+         lock.lock();
+         if (--busy == 0) done.notify_one();
+      }
+   }
+
+private:
+   std::vector<std::thread> threads;
+   std::mutex mutex;
+   std::condition_variable start;
+   std::condition_variable done;
+
+   const std::function<void(std::size_t)>* pTask;
+   std::size_t taskCount;
+   std::atomic<std::size_t> nextTask;
+   std::size_t busy;          // workers that have not finished the current loop
+   std::uint64_t generation;  // the number of loops started
+   bool bStop;
+};
+
+// Row of a tiled_table, returned by tiled_table::operator[].
+template<class Table>
+class tiled_row
+{
+public:
+   tiled_row(Table& table, std::size_t i) : table(table), i(i){}
+
+   auto& operator[](std::size_t j) const
+   {
+      return table(i, j);
+   }
+
+private:
+   Table& table;
+   std::size_t i;
+};
+
+// Class **tiled_table** is a 2D DP table stored by tiles: every
+// TileSize x TileSize tile occupies a contiguous block of memory. In a
+// row-major table, cells (i, j) and (i + 1, j) are a whole row apart,
+// so DPs over large grids miss the cache on every dependency between
+// rows; in a tiled table both cells are usually in the same tile.
+// Combine it with for_each_wavefront, which walks the table tile by tile.
+//
+// Use function **create_tiled_table** in place of create_table(n, m, value).
+//
+// Example:
+//   auto dist = alg::create_tiled_table(n + 1, m + 1, 0);
+//   dist[i][j] = std::min(dist[i - 1][j] + 1, dist[i][j - 1] + 1);
+template<class T, std::size_t TileSize = 64>
+class tiled_table
+{
+   static_assert((TileSize > 0) && ((TileSize & (TileSize - 1)) == 0),
+                 "The tile size must be a power of two.");
+
+public:
+   tiled_table(std::size_t nRows, std::size_t nCols, const T& value) :
+      nRows(nRows), nCols(nCols), tileCols((nCols + TileSize - 1) / TileSize),
+      cells(((nRows + TileSize - 1) / TileSize) * tileCols * TileSize * TileSize, value)
+   {
+   }
+
+   T& operator()(std::size_t i, std::size_t j)
+   {
+      return cells[offset(i, j)];
+   }
+
+   const T& operator()(std::size_t i, std::size_t j) const
+   {
+      return cells[offset(i, j)];
+   }
+
+   tiled_row<tiled_table> operator[](std::size_t i)
+   {
+      return tiled_row<tiled_table>(*this, i);
+   }
+
+   tiled_row<const tiled_table> operator[](std::size_t i) const
+   {
+      return tiled_row<const tiled_table>(*this, i);
+   }
+
+   std::size_t rows() const
+   {
+      return nRows;
+   }
+
+   std::size_t cols() const
+   {
+      return nCols;
+   }
+
+   static constexpr std::size_t tile_size()
+   {
+      return TileSize;
+   }
+
+private:
+   std::size_t offset(std::size_t i, std::size_t j) const
+   {
+      std::size_t tile = (i / TileSize) * tileCols + (j / TileSize);
+      return (tile * TileSize + (i % TileSize)) * TileSize + (j % TileSize);
+   }
+
+private:
+   std::size_t nRows;
+   std::size_t nCols;
+   std::size_t tileCols;
+   std::vector<T> cells;
+};
+
+template<typename T>
+auto create_tiled_table(std::size_t nRows, std::size_t nCols, T value)
+{
+   return tiled_table<T>(nRows, nCols, value);
+}
+
+// Function **for_each_wavefront** walks an nRows x nCols grid tile by
+// tile, calling func(rowBegin, rowEnd, colBegin, colEnd) for every tile.
+// The tiles are visited by anti-diagonals, so when func is called for
+// a tile, the tiles above it and to the left of it are finished. This
+// is what DPs in which cell (i, j) depends on cells (i - 1, j),
+// (i, j - 1) and (i - 1, j - 1) need. If a thread pool is given, tiles on
+// the same anti-diagonal are processed in parallel.
+//
+// Example (edit distance):
+//   auto dist = alg::create_tiled_table(n + 1, m + 1, 0);
+//   ... // fill in row 0 and column 0
+//   alg::thread_pool pool;
+//   alg::for_each_wavefront(n, m, dist.tile_size(),
+//      [&](size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd)
+//      {
+//         for (size_t i = iBegin + 1; i <= iEnd; i++)
+//            for (size_t j = jBegin + 1; j <= jEnd; j++)
+//               dist[i][j] = ...;
+//      }, pool);
+template<class Func>
+void for_each_wavefront(std::size_t nRows, std::size_t nCols, std::size_t tileSize,
+                        Func func, thread_pool* pool)
+{
+   if ((nRows == 0) || (nCols == 0)) return;
+
+   std::size_t tileRows = (nRows + tileSize - 1) / tileSize;
+   std::size_t tileCols = (nCols + tileSize - 1) / tileSize;
+
+   for (std::size_t d = 0; d + 1 < tileRows + tileCols; d++)
+   {
+      // tiles (ti, d - ti) of the anti-diagonal
+      std::size_t tiBegin = (d >= tileCols) ? (d - tileCols + 1) : 0;
+      std::size_t tiEnd = std::min(d + 1, tileRows);
+
+      auto processTile = [&](std::size_t k)
+      {
+         std::size_t ti = tiBegin + k;
+         std::size_t tj = d - ti;
+         func(ti * tileSize, std::min((ti + 1) * tileSize, nRows),
+              tj * tileSize, std::min((tj + 1) * tileSize, nCols));
+      };
+
+      if (pool != nullptr)
+      {
+         pool->parallel_for(tiEnd - tiBegin, processTile);
+      }
+      else
+      {
+         for (std::size_t k = 0; k < tiEnd - tiBegin; k++) processTile(k);
+      }
+   }
+}
+
+template<class Func>
+void for_each_wavefront(std::size_t nRows, std::size_t nCols, std::size_t tileSize, Func func)
+{
+   for_each_wavefront(nRows, nCols, tileSize, func, nullptr);
+}
+
+template<class Func>
+void for_each_wavefront(std::size_t nRows, std::size_t nCols, std::size_t tileSize,
+                        Func func, thread_pool& pool)
+{
+   for_each_wavefront(nRows, nCols, tileSize, func, &pool);
+}
+
+namespace detail
+{
+   // Loser tree (tournament tree) over k sorted sequences. Node 0 holds
+   // the winner, the internal nodes hold the losers of their matches, so
+   // taking the next element replays only the log k matches on the path
+   // from the winner's leaf. Equal elements are taken from the sequence
+   // with the smaller index first, so merging is stable.
+   template<class Iter, class Less>
+   class loser_tree
+   {
+   public:
+      loser_tree(const std::vector<Iter>& begins, const std::vector<Iter>& ends, Less less) :
+         cur(begins), ends(ends), less(less)
+      {
+         k = 1;
+         while (k < begins.size()) k *= 2;
+
+         // missing leaves are empty sequences
+         cur.resize(k, Iter());
+         this->ends.resize(k, Iter());
+         tree.resize(k);
+         tree[0] = play(1);
+      }
+
+      bool empty() const
+      {
+         return exhausted(tree[0]);
+      }
+
+      // the sequence that holds the smallest element
+      std::size_t top() const
+      {
+         return tree[0];
+      }
+
+      // takes the smallest element
+      Iter pop()
+      {
+         std::size_t winner = tree[0];
+         Iter result = cur[winner]++;
+
+         for (std::size_t node = (winner + k) / 2; node > 0; node /= 2)
+         {
+            if (beats(tree[node], winner)) std::swap(tree[node], winner);
+         }
+
+         tree[0] = winner;
+         return result;
+      }
+
+   private:
+      bool exhausted(std::size_t i) const
+      {
+         return cur[i] == ends[i];
+      }
+
+      // true if the head of sequence a goes before the head of sequence b
+      bool beats(std::size_t a, std::size_t b) const
+      {
+         if (exhausted(b)) return !exhausted(a);
+         if (exhausted(a)) return false;
+         if (less(*cur[a], *cur[b])) return true;
+         if (less(*cur[b], *cur[a])) return false;
+         return a < b;
+      }
+
+      // plays the matches in the subtree of **node**; returns the winner
+      std::size_t play(std::size_t node)
+      {
+         if (node >= k) return node - k;
+
+         std::size_t left = play(2 * node);
+         std::size_t right = play(2 * node + 1);
+
+         if (beats(left, right))
+         {
+            tree[node] = right;
+            return left;
+         }
+
+         tree[node] = left;
+         return right;
+      }
+
+   private:
+      std::size_t k;
+      std::vector<Iter> cur;
+      std::vector<Iter> ends;
+      std::vector<std::size_t> tree;
+      Less less;
+   };
+
+   template<class Iter, class Less, class OutIter>
+   OutIter merge_k(const std::vector<Iter>& begins, const std::vector<Iter>& ends,
+                   Less less, OutIter out)
+   {
+      loser_tree<Iter, Less> tree(begins, ends, less);
+
+      while (!tree.empty())
+      {
+         *out = *tree.pop();
+         ++out;
+      }
+
+      return out;
+   }
+
+   // Returns the co-ranks of **rank**: positions in the sequences such
+   // that the elements before them are exactly the first **rank**
+   // elements of the stable merge.
+   template<class Iter, class Less>
+   std::vector<std::size_t> co_rank(const std::vector<Iter>& begins, const std::vector<Iter>& ends,
+                                    std::size_t rank, Less less)
+   {
+      std::size_t k = begins.size();
+      std::vector<std::size_t> split(k);
+
+      // the number of elements that go before element **pos** of
+      // sequence **src** in the merge
+      auto countBefore = [&](std::size_t src, std::size_t pos)
+      {
+         const auto& x = begins[src][pos];
+         std::size_t total = 0;
+
+         for (std::size_t i = 0; i < k; i++)
+         {
+            if (i < src)
+            {
+               split[i] = std::upper_bound(begins[i], ends[i], x, less) - begins[i];
+            }
+            else if (i == src)
+            {
+               split[i] = pos;
+            }
+            else
+            {
+               split[i] = std::lower_bound(begins[i], ends[i], x, less) - begins[i];
+            }
+
+            total += split[i];
+         }
+
+         return total;
+      };
+
+      // the element of rank **rank** is in one of the sequences
+      for (std::size_t j = 0; j < k; j++)
+      {
+         std::size_t lo = 0, hi = ends[j] - begins[j];
+
+         while (lo < hi)
+         {
+            std::size_t mid = lo + (hi - lo) / 2;
+
+            if (countBefore(j, mid) <= rank)
+            {
+               lo = mid + 1;
+            }
+            else
+            {
+               hi = mid;
+            }
+         }
+
+         if ((lo > 0) && (countBefore(j, lo - 1) == rank)) return split;
+      }
+
+      // rank is the total size
+      for (std::size_t i = 0; i < k; i++) split[i] = ends[i] - begins[i];
+      return split;
+   }
+
+   template<class Range>
+   using range_iterator = decltype(std::cbegin(std::declval<const Range&>()));
+
+   template<class Range>
+   using range_value = typename std::iterator_traits<range_iterator<Range>>::value_type;
+
+   template<class Range, class Less>
+   auto merge_k(const std::vector<Range>& inputs, Less less, thread_pool* pool)
+   {
+      typedef range_iterator<Range> Iter;
+
+      std::vector<Iter> begins, ends;
+      std::size_t total = 0;
+
+      for (const Range& input : inputs)
+      {
+         begins.push_back(std::cbegin(input));
+         ends.push_back(std::cend(input));
+         total += ends.back() - begins.back();
+      }
+
+      std::vector<range_value<Range>> result(total);
+
+      // parts shorter than this are not worth a thread
+      constexpr std::size_t kMinPart = 1 << 14;
+      std::size_t nParts = (pool != nullptr) ? std::min(pool->size(), total / kMinPart) : 1;
+
+      if (nParts <= 1)
+      {
+         merge_k(begins, ends, less, result.begin());
+         return result;
+      }
+
+      // part p of the output starts at rank p * total / nParts
+      std::vector<std::vector<std::size_t>> splits(nParts + 1);
+      pool->parallel_for(nParts + 1, [&](std::size_t p)
+      {
+         splits[p] = co_rank(begins, ends, p * total / nParts, less);
+      });
+
+      pool->parallel_for(nParts, [&](std::size_t p)
+      {
+         std::vector<Iter> partBegins(begins), partEnds(begins);
+
+         for (std::size_t i = 0; i < begins.size(); i++)
+         {
+            partBegins[i] += splits[p][i];
+            partEnds[i] += splits[p + 1][i];
+         }
+
+         merge_k(partBegins, partEnds, less, result.begin() + p * total / nParts);
+      });
+
+      return result;
+   }
+}
+
+// Function **merge_k_by** merges sequences sorted by a field, e.g.,
+// job lists coming from several producers. It uses a loser tree, so
+// merging k sequences with n elements in total takes O(n log k) time,
+// rather than O(n log n) for concatenating and sorting them. The merge
+// is stable: equal elements keep the order of the sequences.
+//
+// The output can be streamed to an output iterator. The version with a
+// thread pool splits the output into parts at co-ranked positions (the
+// positions in the inputs where each part starts) and merges the parts
+// in parallel.
+//
+// Examples:
+//   std::vector<std::vector<Job>> streams = ...;   // sorted by finish time
+//   auto jobs = alg::merge_k_by<&Job::finish>(streams);
+//
+//   alg::merge_k_by<&Job::finish>(streams, std::back_inserter(jobs));
+//
+//   alg::thread_pool pool;
+//   auto jobs = alg::merge_k_by<&Job::finish>(streams, pool);
+template<auto Field, class Range, class OutIter>
+OutIter merge_k_by(const std::vector<Range>& inputs, OutIter out, bool bAscending = true)
+{
+   std::vector<detail::range_iterator<Range>> begins, ends;
+
+   for (const Range& input : inputs)
+   {
+      begins.push_back(std::cbegin(input));
+      ends.push_back(std::cend(input));
+   }
+
+   if (bAscending)
+   {
+      return detail::merge_k(begins, ends, [](const auto& a, const auto& b){return (a.*Field < b.*Field);}, out);
+   }
+   else
+   {
+      return detail::merge_k(begins, ends, [](const auto& a, const auto& b){return (a.*Field > b.*Field);}, out);
+   }
+}
+
+template<auto Field, class Range>
+auto merge_k_by(const std::vector<Range>& inputs, bool bAscending = true)
+{
+   if (bAscending)
+   {
+      return detail::merge_k(inputs, [](const auto& a, const auto& b){return (a.*Field < b.*Field);}, nullptr);
+   }
+   else
+   {
+      return detail::merge_k(inputs, [](const auto& a, const auto& b){return (a.*Field > b.*Field);}, nullptr);
+   }
+}
+
+template<auto Field, class Range>
+auto merge_k_by(const std::vector<Range>& inputs, thread_pool& pool, bool bAscending = true)
+{
+   if (bAscending)
+   {
+      return detail::merge_k(inputs, [](const auto& a, const auto& b){return (a.*Field < b.*Field);}, &pool);
+   }
+   else
+   {
+      return detail::merge_k(inputs, [](const auto& a, const auto& b){return (a.*Field > b.*Field);}, &pool);
+   }
+}
+
+namespace detail
+{
+   // Maps integer keys to unsigned ones with the same order.
+   template<class Key>
+   std::make_unsigned_t<Key> radix_key(Key key)
+   {
+      typedef std::make_unsigned_t<Key> U;
+      U u = static_cast<U>(key);
+      if (std::is_signed<Key>::value) u ^= U(1) << (std::numeric_limits<U>::digits - 1);
+      return u;
+   }
+
+   // how far ahead gathers prefetch
+   constexpr std::size_t kGatherPrefetch = 16;
+
+   // Stable LSD radix sort of **perm** by keys[perm[i]], one byte per pass.
+   // Passes over bytes that are the same for all keys are skipped.
+   template<class Key>
+   void radix_sort_by_column(const std::vector<Key>& keys, std::vector<std::uint32_t>& perm,
+                             std::vector<std::uint32_t>& buffer)
+   {
+      static_assert(std::is_integral<Key>::value, "Keys must be integers.");
+      static_assert(!std::is_same<Key, bool>::value, "Keys must not be bool.");
+
+      constexpr std::size_t kBytes = sizeof(Key);
+      std::size_t n = perm.size();
+      assert(keys.size() == n);
+      if (n == 0) return;
+
+      // histograms of all bytes in one pass
+      std::vector<std::array<std::size_t, 256>> counts(kBytes);
+      for (auto& histogram : counts) histogram.fill(0);
+
+      for (Key key : keys)
+      {
+         auto u = radix_key(key);
+         for (std::size_t b = 0; b < kBytes; b++) counts[b][(u >> (8 * b)) & 0xff]++;
+      }
+
+      buffer.resize(n);
+
+      for (std::size_t b = 0; b < kBytes; b++)
+      {
+         auto digit = [&](std::uint32_t i){return (radix_key(keys[i]) >> (8 * b)) & 0xff;};
+
+         if (counts[b][digit(0)] == n) continue;
+
+         std::size_t offsets[256];
+         std::size_t sum = 0;
+         for (std::size_t d = 0; d < 256; d++)
+         {
+            offsets[d] = sum;
+            sum += counts[b][d];
+         }
+
+         for (std::size_t i = 0; i < n; i++)
+         {
+            if (i + kGatherPrefetch < n) prefetch(&keys[perm[i + kGatherPrefetch]]);
+
+            std::uint32_t id = perm[i];
+            buffer[offsets[digit(id)]++] = id;
+         }
+
+         perm.swap(buffer);
+      }
+   }
+
+   inline void argsort_columns(std::vector<std::uint32_t>&, std::vector<std::uint32_t>&)
+   {
+   }
+
+   // sorts by the last column first, so that the first column is the primary key
+   template<class Column, class... Columns>
+   void argsort_columns(std::vector<std::uint32_t>& perm, std::vector<std::uint32_t>& buffer,
+                        const Column& column, const Columns&... columns)
+   {
+      argsort_columns(perm, buffer, columns...);
+      radix_sort_by_column(column, perm, buffer);
+   }
+
+   template<class Column>
+   void gather(const std::vector<std::uint32_t>& perm, Column& column)
+   {
+      std::size_t n = perm.size();
+      assert(column.size() == n);
+
+      Column result;
+      result.reserve(n);
+
+      for (std::size_t i = 0; i < n; i++)
+      {
+         if (i + kGatherPrefetch < n) prefetch(&column[perm[i + kGatherPrefetch]]);
+         result.push_back(std::move(column[perm[i]]));
+      }
+
+      column.swap(result);
+   }
+}
+
+// Function **argsort_by** returns the permutation that sorts data
+// stored by columns, e.g., separate vectors of start and finish times.
+// The first column is the primary key, the next one breaks ties, and so
+// on. The sort is stable (a least significant digit radix sort), so it
+// takes O(n) time per key byte. The keys must be integers (not bool),
+// and all key columns must have the same size.
+//
+// Function **apply_permutation** reorders any number of columns by
+// a permutation: column[i] becomes column[perm[i]]. Every column must
+// have the size of the permutation.
+//
+// Examples:
+//   // order of jobs by finish time, and then by start time
+//   std::vector<std::uint32_t> order = alg::argsort_by(finish, start);
+//   for (auto i : order) ... start[i], finish[i] ...
+//
+//   alg::apply_permutation(order, start, finish, weight);
+template<class Column, class... Columns>
+std::vector<std::uint32_t> argsort_by(const Column& column, const Columns&... columns)
+{
+   std::vector<std::uint32_t> perm(column.size());
+   std::iota(perm.begin(), perm.end(), 0);
+
+   std::vector<std::uint32_t> buffer;
+   detail::argsort_columns(perm, buffer, column, columns...);
+
+   return perm;
+}
+
+template<class... Columns>
+void apply_permutation(const std::vector<std::uint32_t>& perm, Columns&... columns)
+{
+   (detail::gather(perm, columns), ...);
+}
+
 //end of the namespace alg
 }
-#endif //_concise_h_
\ No newline at end of file
+#endif //_concise_h_
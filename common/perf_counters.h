@@ -0,0 +1,373 @@
+////////////////////////////////////////////////////////////////////////////
+// Hardware performance counters of the calling thread (Linux
+// perf_event_open).
+//
+// A CounterGroup opens the counters of cycles, instructions, L1 data
+// cache misses, last level cache misses and branch misses as one group,
+// so that they count the same instructions and are read with one system
+// call. Only user-space events are counted, which perf_event_paranoid
+// up to 2 allows. Counters that cannot be opened (other systems,
+// containers without perf events, virtual machines without a PMU) are
+// reported as not available, and reading them gives zeros.
+//
+// Example:
+//   PerfCounters::CounterGroup counters;
+//   PerfCounters::Sample before = counters.Read();
+//   Solve();
+//   PerfCounters::Sample delta = counters.Read() - before;
+//   std::cout << delta.Ipc();
+//
+
+#ifndef _perf_counters_h_
+#define _perf_counters_h_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#define PERF_COUNTERS_HAS_PERF_EVENT 1
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define PERF_COUNTERS_HAS_PERF_EVENT 0
+#endif
+
+namespace PerfCounters
+{
+   enum Event
+   {
+      Cycles = 0,
+      Instructions,
+      L1DMisses,
+      LLCMisses,
+      BranchMisses,
+      kEventCount
+   };
+
+   const char* GetEventName(Event event)
+   {
+      static const char* const names[kEventCount] =
+         {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+
+      return names[event];
+   }
+
+   // Counts of the events; the counts of events that are not available
+   // are zeros.
+   struct Sample
+   {
+      uint64_t counts[kEventCount] = {};
+
+      uint64_t operator [](Event event) const { return counts[event]; }
+
+      Sample operator -(const Sample& other) const;
+      Sample& operator +=(const Sample& other);
+
+      // Instructions per cycle; 0 if cycles are not counted.
+      double Ipc() const;
+
+      // Events per 1000 instructions.
+      double PerKiloInstruction(Event event) const;
+   };
+
+   class CounterGroup
+   {
+   public:
+      // Opens and starts the counters.
+      CounterGroup();
+      ~CounterGroup();
+
+      CounterGroup(const CounterGroup&) = delete;
+      CounterGroup& operator=(const CounterGroup&) = delete;
+
+      bool IsAvailable() const;
+      bool IsAvailable(Event event) const;
+
+      // Why the counters are not available, e.g., "Permission denied".
+      const std::string& GetError() const;
+
+      // The counts since the group was opened. If the kernel had to
+      // multiplex the counters, the counts are scaled to the full time.
+      Sample Read() const;
+
+   private:
+      int fds[kEventCount];
+      int leader;
+      std::string error;
+   };
+
+   // The counters of a solve loop: the total, and every problem measured
+   // on its own (a read of the counters before and after it).
+   class ProblemSetCounters
+   {
+   public:
+      void AddProblem(const Sample& sample);
+      void SetTotal(const Sample& sample);
+
+      void Print(std::ostream& out, const CounterGroup& counters) const;
+
+   private:
+      Sample total;
+      Sample problemSum;
+      Sample slowestProblem;
+      size_t slowestIndex = 0;
+      size_t nProblems = 0;
+   };
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   Sample Sample::operator -(const Sample& other) const
+   {
+      Sample result;
+
+      for (int i = 0; i < kEventCount; i++)
+      {
+         result.counts[i] = counts[i] - other.counts[i];
+      }
+
+      return result;
+   }
+
+   Sample& Sample::operator +=(const Sample& other)
+   {
+      for (int i = 0; i < kEventCount; i++)
+      {
+         counts[i] += other.counts[i];
+      }
+
+      return *this;
+   }
+
+   double Sample::Ipc() const
+   {
+      return (counts[Cycles] == 0) ? 0 : static_cast<double>(counts[Instructions]) / counts[Cycles];
+   }
+
+   double Sample::PerKiloInstruction(Event event) const
+   {
+      return (counts[Instructions] == 0) ? 0 : 1000.0 * counts[event] / counts[Instructions];
+   }
+
+#if PERF_COUNTERS_HAS_PERF_EVENT
+   namespace Detail
+   {
+      void SetEventConfig(Event event, perf_event_attr& attr)
+      {
+         const uint64_t kCacheMiss = static_cast<uint64_t>(PERF_COUNT_HW_CACHE_OP_READ) << 8 |
+                                     static_cast<uint64_t>(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16;
+
+         switch (event)
+         {
+         case Cycles:       attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+         case Instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+         case L1DMisses:    attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_L1D | kCacheMiss; break;
+         case LLCMisses:    attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_LL | kCacheMiss; break;
+         default:           attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+         }
+      }
+
+      int OpenEvent(Event event, int groupFd)
+      {
+         perf_event_attr attr;
+         std::memset(&attr, 0, sizeof(attr));
+
+         attr.size = sizeof(attr);
+         SetEventConfig(event, attr);
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+         attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+         // the calling thread on any CPU
+         return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+      }
+   }
+#endif
+
+   CounterGroup::CounterGroup() : leader(-1)
+   {
+      std::fill(fds, fds + kEventCount, -1);
+
+#if PERF_COUNTERS_HAS_PERF_EVENT
+      // The first event that opens leads the group; events that
+      // cannot be opened (e.g., LLC misses on some CPUs) are left out.
+      for (int i = 0; i < kEventCount; i++)
+      {
+         fds[i] = Detail::OpenEvent(static_cast<Event>(i), leader);
+
+         if (fds[i] < 0)
+         {
+            if (error.empty()) error = std::strerror(errno);
+         }
+         else if (leader < 0)
+         {
+            leader = fds[i];
+         }
+      }
+
+      if (leader >= 0)
+      {
+         error.clear();
+         ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+         ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+#else
+      error = "perf_event_open is not supported on this system";
+#endif
+   }
+
+   CounterGroup::~CounterGroup()
+   {
+#if PERF_COUNTERS_HAS_PERF_EVENT
+      for (int i = 0; i < kEventCount; i++)
+      {
+         if (fds[i] >= 0) close(fds[i]);
+      }
+#endif
+   }
+
+   bool CounterGroup::IsAvailable() const
+   {
+      return (leader >= 0);
+   }
+
+   bool CounterGroup::IsAvailable(Event event) const
+   {
+      return (fds[event] >= 0);
+   }
+
+   const std::string& CounterGroup::GetError() const
+   {
+      return error;
+   }
+
+   Sample CounterGroup::Read() const
+   {
+      Sample sample;
+
+#if PERF_COUNTERS_HAS_PERF_EVENT
+      if (leader < 0) return sample;
+
+      // nr, time_enabled, time_running, then {value, id} for every event
+      uint64_t buffer[3 + 2 * kEventCount];
+      ssize_t size = read(leader, buffer, sizeof(buffer));
+      if (size < static_cast<ssize_t>(3 * sizeof(uint64_t))) return sample;
+
+      uint64_t nEvents = std::min<uint64_t>(buffer[0], kEventCount);
+      double scale = ((buffer[2] != 0) && (buffer[2] < buffer[1])) ?
+                     static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+
+      // the events of the group in the order they were opened
+      int event = 0;
+      for (uint64_t k = 0; k < nEvents; k++)
+      {
+         while ((event < kEventCount) && (fds[event] < 0)) event++;
+         if (event == kEventCount) break;
+
+         uint64_t value = buffer[3 + 2 * k];
+         sample.counts[event] = (scale == 1.0) ? value : static_cast<uint64_t>(value * scale);
+         event++;
+      }
+#endif
+
+      return sample;
+   }
+
+   void ProblemSetCounters::AddProblem(const Sample& sample)
+   {
+      if ((nProblems == 0) || (sample[Cycles] > slowestProblem[Cycles]))
+      {
+         slowestProblem = sample;
+         slowestIndex = nProblems;
+      }
+
+      problemSum += sample;
+      nProblems++;
+   }
+
+   void ProblemSetCounters::SetTotal(const Sample& sample)
+   {
+      total = sample;
+   }
+
+   void ProblemSetCounters::Print(std::ostream& out, const CounterGroup& counters) const
+   {
+      if (!counters.IsAvailable())
+      {
+         out << "Hardware counters are not available (" << counters.GetError() << ")." << std::endl;
+         return;
+      }
+
+      out << "Hardware counters of the solve loop (" << nProblems << " problem(s)):" << std::endl;
+
+      for (int i = 0; i < kEventCount; i++)
+      {
+         Event event = static_cast<Event>(i);
+         out << "  " << GetEventName(event) << ": ";
+
+         if (!counters.IsAvailable(event))
+         {
+            out << "not available" << std::endl;
+            continue;
+         }
+
+         out << total[event];
+
+         if (nProblems > 0)
+         {
+            out << ", " << problemSum[event] / nProblems << " per problem";
+         }
+
+         if ((event != Cycles) && (event != Instructions))
+         {
+            out << ", " << total.PerKiloInstruction(event) << " per 1000 instructions";
+         }
+
+         out << std::endl;
+      }
+
+      out << "  IPC: " << total.Ipc() << std::endl;
+
+      if (nProblems > 0)
+      {
+         out << "  Most cycles: problem #" << (slowestIndex + 1) << ", "
+             << slowestProblem[Cycles] << " cycles, IPC " << slowestProblem.Ipc() << std::endl;
+      }
+   }
+
+   // Solves the problems once, reading the counters around the loop and
+   // around every problem, and prints the counts. Reading the counters
+   // is a system call, which the per-problem counts include.
+   template<class T, class Solver>
+   void CountProblemSet(std::vector<T>& problems, Solver solve, std::ostream& out = std::cout)
+   {
+      CounterGroup counters;
+      ProblemSetCounters results;
+
+      Sample start = counters.Read();
+      Sample previous = start;
+
+      for (T& theProblem : problems)
+      {
+         solve(theProblem);
+
+         Sample now = counters.Read();
+         results.AddProblem(now - previous);
+         previous = now;
+      }
+
+      results.SetTotal(previous - start);
+
+      out << std::endl;
+      results.Print(out, counters);
+   }
+}
+
+#endif //_perf_counters_h_
@@ -0,0 +1,386 @@
+////////////////////////////////////////////////////////////////////////////
+// In-process sampling profiler (Linux, x86-64 and AArch64).
+//
+// While the profiler runs, setitimer(ITIMER_PROF) sends SIGPROF every
+// 1/frequency seconds of CPU time of the process, and the signal handler
+// stores the stack of the interrupted thread in a buffer allocated when
+// the profiler starts; the handler does not allocate or lock. Stacks
+// are walked by frame pointers within the stack of the thread, which is
+// known for the threads that called RegisterThread (the thread that
+// starts the profiler is registered); samples of other threads have
+// only the interrupted function.
+//
+// At the end, the samples are written as folded stacks, one line per
+// stack ("main;Solve;Sort 42"), the input of flamegraph.pl and of
+// speedscope. Frames are named by dladdr, so compile with frame pointers
+// and export the symbols of the executable:
+//   g++ -std=c++17 -O3 -fno-omit-frame-pointer -rdynamic scheduler.cpp
+// Frames without a symbol are written as module+offset.
+//
+// The profiler starts before main if the environment variable
+// PROFILE_FILE names the output file (PROFILE_HZ sets the frequency)
+// and writes the file at exit.
+//
+// Example:
+//   PROFILE_FILE=scheduler.folded ./scheduler.out
+//   flamegraph.pl scheduler.folded > scheduler.svg
+//
+
+#ifndef _sampling_profiler_h_
+#define _sampling_profiler_h_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define SAMPLING_PROFILER_SUPPORTED 1
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#else
+#define SAMPLING_PROFILER_SUPPORTED 0
+#endif
+
+namespace Profiler
+{
+   struct Options
+   {
+      int frequency = 997;     // samples per second of CPU time
+      size_t capacity = 32768; // samples kept; later ones are counted as dropped
+   };
+
+   // Starts sampling; returns false if the profiler is running already
+   // or is not supported.
+   bool Start(const Options& options = Options());
+
+   // Stops sampling; the samples are kept.
+   void Stop();
+
+   // Makes the stack of the calling thread known to the profiler, so that
+   // its samples have full stacks; calls after the first one return at once.
+   void RegisterThread();
+
+   size_t GetSampleCount();
+   size_t GetDroppedCount();
+
+   // Writes the samples as folded stacks; returns false on errors.
+   bool WriteFoldedStacks(const char* filename);
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   namespace Detail
+   {
+      constexpr size_t kMaxDepth = 64;
+
+      struct Sample
+      {
+         std::atomic<uint32_t> depth;
+         uintptr_t frames[kMaxDepth];
+      };
+
+      struct State
+      {
+         std::unique_ptr<Sample[]> samples;
+         size_t capacity = 0;
+         std::atomic<size_t> nSamples{0};
+         std::atomic<size_t> nDropped{0};
+         std::atomic<bool> bRunning{false};
+         std::string filename;
+      };
+
+      State& GetState()
+      {
+         static State state;
+         return state;
+      }
+
+      // The stack of the thread, set by RegisterThread.
+      thread_local uintptr_t stackLow = 0;
+      thread_local uintptr_t stackHigh = 0;
+
+#if SAMPLING_PROFILER_SUPPORTED
+      struct sigaction previousAction;
+
+      void GetRegisters(const void* context, uintptr_t& pc, uintptr_t& fp, uintptr_t& sp)
+      {
+         const mcontext_t& mc = static_cast<const ucontext_t*>(context)->uc_mcontext;
+
+#if defined(__x86_64__)
+         pc = static_cast<uintptr_t>(mc.gregs[REG_RIP]);
+         fp = static_cast<uintptr_t>(mc.gregs[REG_RBP]);
+         sp = static_cast<uintptr_t>(mc.gregs[REG_RSP]);
+#else
+         pc = static_cast<uintptr_t>(mc.pc);
+         fp = static_cast<uintptr_t>(mc.regs[29]);
+         sp = static_cast<uintptr_t>(mc.sp);
+#endif
+      }
+
+      // Async-signal-safe: atomics and reads of the stack of the thread.
+      // A frame is {previous frame pointer, return address}; frames must
+      // go up the stack, or the walk stops (e.g., in code compiled
+      // without frame pointers).
+      void HandleSignal(int /* signal */, siginfo_t* /* info */, void* context)
+      {
+         int savedErrno = errno;
+         State& state = GetState();
+
+         size_t slot = state.nSamples.fetch_add(1, std::memory_order_relaxed);
+         if (slot >= state.capacity)
+         {
+            state.nSamples.fetch_sub(1, std::memory_order_relaxed);
+            state.nDropped.fetch_add(1, std::memory_order_relaxed);
+            errno = savedErrno;
+            return;
+         }
+
+         // the slot may hold a sample of an earlier run; a reader that
+         // sees depth 0 skips the sample while it is written
+         Sample& sample = state.samples[slot];
+         sample.depth.store(0, std::memory_order_relaxed);
+
+         uintptr_t pc, fp, sp;
+         GetRegisters(context, pc, fp, sp);
+
+         uint32_t depth = 0;
+         sample.frames[depth++] = pc;
+
+         uintptr_t low = (sp > stackLow) ? sp : stackLow;
+
+         while ((depth < kMaxDepth) && (fp >= low) && (fp + 2 * sizeof(uintptr_t) <= stackHigh) &&
+                (fp % sizeof(uintptr_t) == 0))
+         {
+            const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+            uintptr_t returnAddress = frame[1];
+            if (returnAddress == 0) break;
+
+            sample.frames[depth++] = returnAddress;
+
+            if (frame[0] <= fp) break;
+            fp = frame[0];
+         }
+
+         sample.depth.store(depth, std::memory_order_release);
+         errno = savedErrno;
+      }
+
+      // "function" (demangled), or "module+0xoffset" without a symbol.
+      std::string Symbolize(uintptr_t address)
+      {
+         Dl_info info;
+         if (dladdr(reinterpret_cast<void*>(address), &info) == 0)
+         {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "0x%lx", static_cast<unsigned long>(address));
+            return buffer;
+         }
+
+         if (info.dli_sname != nullptr)
+         {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name = (status == 0) ? demangled : info.dli_sname;
+            std::free(demangled);
+            return name;
+         }
+
+         const char* module = (info.dli_fname != nullptr) ? std::strrchr(info.dli_fname, '/') : nullptr;
+         module = (module != nullptr) ? module + 1 : ((info.dli_fname != nullptr) ? info.dli_fname : "?");
+
+         char buffer[32];
+         std::snprintf(buffer, sizeof(buffer), "+0x%lx",
+                       static_cast<unsigned long>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+         return std::string(module) + buffer;
+      }
+#endif
+
+      void WriteAtExit()
+      {
+         Stop();
+         WriteFoldedStacks(GetState().filename.c_str());
+      }
+
+      // Reads PROFILE_FILE and PROFILE_HZ once, before main.
+      bool StartFromEnvironment()
+      {
+         const char* filename = std::getenv("PROFILE_FILE");
+         if ((filename == nullptr) || (*filename == 0)) return false;
+
+         Options options;
+         const char* frequency = std::getenv("PROFILE_HZ");
+         if (frequency != nullptr) options.frequency = std::max(1, std::atoi(frequency));
+
+         GetState().filename = filename;
+         if (!Start(options)) return false;
+
+         std::atexit(WriteAtExit);
+         return true;
+      }
+
+      const bool bEnvironmentRead = StartFromEnvironment();
+   }
+
+   void RegisterThread()
+   {
+#if SAMPLING_PROFILER_SUPPORTED
+      if (Detail::stackHigh != 0) return;
+
+      pthread_attr_t attr;
+      if (pthread_getattr_np(pthread_self(), &attr) != 0) return;
+
+      void* address = nullptr;
+      size_t size = 0;
+
+      if (pthread_attr_getstack(&attr, &address, &size) == 0)
+      {
+         Detail::stackLow = reinterpret_cast<uintptr_t>(address);
+         Detail::stackHigh = Detail::stackLow + size;
+      }
+
+      pthread_attr_destroy(&attr);
+#endif
+   }
+
+   bool Start(const Options& options)
+   {
+#if SAMPLING_PROFILER_SUPPORTED
+      Detail::State& state = Detail::GetState();
+      if (state.bRunning.exchange(true)) return false;
+
+      if (state.capacity != options.capacity)
+      {
+         state.samples.reset(new Detail::Sample[options.capacity]());
+         state.capacity = options.capacity;
+      }
+
+      state.nSamples.store(0);
+      state.nDropped.store(0);
+
+      RegisterThread();
+
+      struct sigaction action;
+      std::memset(&action, 0, sizeof(action));
+      action.sa_sigaction = Detail::HandleSignal;
+      action.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&action.sa_mask);
+
+      if (sigaction(SIGPROF, &action, &Detail::previousAction) != 0)
+      {
+         state.bRunning.store(false);
+         return false;
+      }
+
+      itimerval timer;
+      timer.it_interval.tv_sec = 0;
+      timer.it_interval.tv_usec = std::max(1, 1000000 / std::max(options.frequency, 1));
+      timer.it_value = timer.it_interval;
+
+      if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+      {
+         sigaction(SIGPROF, &Detail::previousAction, nullptr);
+         state.bRunning.store(false);
+         return false;
+      }
+
+      return true;
+#else
+      (void) options;
+      return false;
+#endif
+   }
+
+   // The handler is left installed: a signal already pending would
+   // otherwise terminate the process (the default action of SIGPROF).
+   void Stop()
+   {
+#if SAMPLING_PROFILER_SUPPORTED
+      Detail::State& state = Detail::GetState();
+      if (!state.bRunning.load()) return;
+
+      itimerval timer;
+      std::memset(&timer, 0, sizeof(timer));
+      setitimer(ITIMER_PROF, &timer, nullptr);
+
+      state.bRunning.store(false);
+#endif
+   }
+
+   size_t GetSampleCount()
+   {
+      Detail::State& state = Detail::GetState();
+      return std::min(state.nSamples.load(), state.capacity);
+   }
+
+   size_t GetDroppedCount()
+   {
+      return Detail::GetState().nDropped.load();
+   }
+
+   // Return addresses point after the calls; address - 1 is in the
+   // calling function. Stacks are written from the root to the leaf.
+   bool WriteFoldedStacks(const char* filename)
+   {
+#if SAMPLING_PROFILER_SUPPORTED
+      Detail::State& state = Detail::GetState();
+
+      std::map<uintptr_t, std::string> names;
+      std::map<std::string, size_t> stacks;
+
+      auto getName = [&names](uintptr_t address) -> const std::string&
+      {
+         auto it = names.find(address);
+         if (it == names.end())
+         {
+            std::string name = Detail::Symbolize(address);
+            std::replace(name.begin(), name.end(), ';', ':');
+            it = names.emplace(address, std::move(name)).first;
+         }
+         return it->second;
+      };
+
+      size_t nSamples = GetSampleCount();
+      for (size_t i = 0; i < nSamples; i++)
+      {
+         const Detail::Sample& sample = state.samples[i];
+         uint32_t depth = std::min<uint32_t>(sample.depth.load(std::memory_order_acquire), Detail::kMaxDepth);
+         if (depth == 0) continue;
+
+         std::string stack;
+         for (uint32_t k = depth; k-- > 0; )
+         {
+            uintptr_t address = (k == 0) ? sample.frames[k] : sample.frames[k] - 1;
+            if (!stack.empty()) stack += ';';
+            stack += getName(address);
+         }
+
+         stacks[stack]++;
+      }
+
+      FILE* file = std::fopen(filename, "w");
+      if (file == nullptr) return false;
+
+      for (const auto& stack : stacks)
+      {
+         std::fprintf(file, "%s %zu\n", stack.first.c_str(), stack.second);
+      }
+
+      return (std::fclose(file) == 0);
+#else
+      (void) filename;
+      return false;
+#endif
+   }
+}
+
+#endif //_sampling_profiler_h_
@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////////////////////
+// Empirical growth of running time.
+//
+// Run times a solver on generated inputs of sizes 2^minLog2, 2^(minLog2
+// + 1), ..., up to 2^maxLog2 or until one size takes longer than the
+// time limit, and fits the times to c * n^a * log^b n, with b fixed to
+// the expected power of the logarithm (fitting both a and b is ill
+// conditioned on such a range of sizes). The study fails if the fitted
+// exponent a exceeds the expected exponent by more than the tolerance,
+// e.g., if an O(n log n) algorithm grows as n^2.
+//
+// Example:
+//   ScalingStudy::Expectation nLogN = {1, 1};
+//   ScalingStudy::Result result = ScalingStudy::Run(
+//      [](size_t n) { return RandomVector(n); },
+//      [](const std::vector<int>& v) { auto c = v; std::sort(c.begin(), c.end()); },
+//      nLogN);
+//   ScalingStudy::PrintResult(std::cout, "std::sort", result, nLogN);
+//
+
+#ifndef _scaling_study_h_
+#define _scaling_study_h_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+namespace ScalingStudy
+{
+   // The running time is expected to be O(n^exponent * log^logExponent n).
+   struct Expectation
+   {
+      double exponent = 1;
+      double logExponent = 0;
+      double tolerance = 0.15;
+   };
+
+   struct Options
+   {
+      int minLog2 = 10;
+      int maxLog2 = 30;
+
+      // No larger sizes are tried after a size takes longer than this.
+      double maxSecondsPerSize = 1.0;
+
+      // Small inputs are solved repeatedly for at least this long, and
+      // the smallest of **repetitions** such averages is taken.
+      double minSecondsPerMeasurement = 0.01;
+      int repetitions = 3;
+   };
+
+   struct Measurement
+   {
+      size_t n;
+      double seconds;
+   };
+
+   // seconds = c * n^a * log2(n)^b
+   struct Fit
+   {
+      double c = 0;
+      double a = 0;
+      double b = 0;
+      double rSquared = 0;
+   };
+
+   struct Result
+   {
+      std::vector<Measurement> measurements;
+
+      // with b = the expected logExponent, and with b = 0
+      Fit fit;
+      Fit powerFit;
+
+      // false if a exceeds the expectation or there are fewer than
+      // three sizes to fit
+      bool bPassed = false;
+   };
+
+   // **generate(n)** returns an input of size n, and **solve(input)**
+   // solves it; solving the same input again must take the same time.
+   template<class Generate, class Solve>
+   Result Run(Generate generate, Solve solve, const Expectation& expectation,
+              const Options& options = Options());
+
+   // Least squares fit of log2(seconds) - b * log2(log2(n)) = log2(c) + a * log2(n).
+   Fit FitGrowth(const std::vector<Measurement>& measurements, double b);
+
+   void PrintResult(std::ostream& out, const char* name, const Result& result,
+                    const Expectation& expectation);
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   template<class Input, class Solve>
+   double MeasureSolve(Input& input, Solve& solve, const Options& options)
+   {
+      typedef std::chrono::steady_clock Clock;
+
+      double best = 0;
+      long count = 1;
+
+      for (int rep = 0; rep < std::max(options.repetitions, 1); rep++)
+      {
+         while (true)
+         {
+            Clock::time_point tStart = Clock::now();
+            for (long i = 0; i < count; i++) solve(input);
+            double seconds = std::chrono::duration<double>(Clock::now() - tStart).count();
+
+            // the first repetition finds the count of calls
+            if ((seconds >= options.minSecondsPerMeasurement) || (rep > 0))
+            {
+               double perCall = seconds / count;
+               best = (rep == 0) ? perCall : std::min(best, perCall);
+               break;
+            }
+
+            count *= 2;
+         }
+
+         // one call is enough to tell that a size is too slow to repeat
+         if (best * count > options.maxSecondsPerSize) break;
+      }
+
+      return best;
+   }
+
+   template<class Generate, class Solve>
+   Result Run(Generate generate, Solve solve, const Expectation& expectation, const Options& options)
+   {
+      Result result;
+
+      for (int k = options.minLog2; k <= options.maxLog2; k++)
+      {
+         size_t n = size_t(1) << k;
+         auto input = generate(n);
+
+         double seconds = MeasureSolve(input, solve, options);
+         result.measurements.push_back({n, seconds});
+
+         if (seconds > options.maxSecondsPerSize) break;
+      }
+
+      if (result.measurements.size() >= 3)
+      {
+         result.fit = FitGrowth(result.measurements, expectation.logExponent);
+         result.powerFit = FitGrowth(result.measurements, 0);
+         result.bPassed = (result.fit.a <= expectation.exponent + expectation.tolerance);
+      }
+
+      return result;
+   }
+
+   Fit FitGrowth(const std::vector<Measurement>& measurements, double b)
+   {
+      Fit fit;
+      fit.b = b;
+
+      size_t count = 0;
+      double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+
+      std::vector<double> xs;
+      std::vector<double> ys;
+
+      for (const Measurement& m : measurements)
+      {
+         if ((m.n < 2) || (m.seconds <= 0)) continue;
+
+         double x = std::log2(static_cast<double>(m.n));
+         double y = std::log2(m.seconds) - b * std::log2(x);
+
+         xs.push_back(x);
+         ys.push_back(y);
+         sumX += x;
+         sumY += y;
+         sumXX += x * x;
+         sumXY += x * y;
+         count++;
+      }
+
+      double denominator = count * sumXX - sumX * sumX;
+      if ((count < 2) || (denominator == 0)) return fit;
+
+      fit.a = (count * sumXY - sumX * sumY) / denominator;
+      double intercept = (sumY - fit.a * sumX) / count;
+      fit.c = std::exp2(intercept);
+
+      double meanY = sumY / count;
+      double total = 0, residual = 0;
+
+      for (size_t i = 0; i < count; i++)
+      {
+         double predicted = intercept + fit.a * xs[i];
+         total += (ys[i] - meanY) * (ys[i] - meanY);
+         residual += (ys[i] - predicted) * (ys[i] - predicted);
+      }
+
+      fit.rSquared = (total == 0) ? 1 : 1 - residual / total;
+      return fit;
+   }
+
+   void PrintResult(std::ostream& out, const char* name, const Result& result,
+                    const Expectation& expectation)
+   {
+      out << std::endl << "Scaling of " << name << ":" << std::endl;
+
+      for (const Measurement& m : result.measurements)
+      {
+         out << "  n = 2^" << static_cast<int>(std::round(std::log2(static_cast<double>(m.n))))
+             << ": " << m.seconds * 1e9 / m.n << " ns per element" << std::endl;
+      }
+
+      if (result.measurements.size() < 3)
+      {
+         out << "  Too few sizes to fit the growth." << std::endl;
+         return;
+      }
+
+      out << "  Fit: n^" << result.fit.a;
+      if (result.fit.b != 0) out << " log^" << result.fit.b << " n";
+      out << " (R^2 " << result.fit.rSquared << "); without the logarithm: n^"
+          << result.powerFit.a << "." << std::endl;
+
+      out << "  Expected: n^" << expectation.exponent;
+      if (expectation.logExponent != 0) out << " log^" << expectation.logExponent << " n";
+      out << " -> " << (result.bPassed ? "OK" : "FAILED: grows faster than expected") << "." << std::endl;
+   }
+}
+
+#endif //_scaling_study_h_
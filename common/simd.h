@@ -0,0 +1,697 @@
+////////////////////////////////////////////////////////////////////////////
+// Runtime dispatch of SIMD kernels.
+//
+// A binary compiled without -march=native can still use AVX2 and AVX-512:
+// every kernel has scalar, SSE2, AVX2 and AVX-512 versions, the vector
+// versions are compiled with function target attributes, and the best
+// version supported by the CPU is chosen once, when the kernels are
+// first used. The environment variable SIMD_LEVEL (scalar, sse2, avx2,
+// avx512) limits the choice, e.g., to compare the versions.
+//
+// Example:
+//   Simd::ReplaceWhitespace(buffer, length, '-');
+//   std::cout << Simd::GetLevelName(Simd::Dispatch().level);
+//
+
+#ifndef _simd_h_
+#define _simd_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+// Compile with -DSIMD_X86=0 to build only the scalar kernels.
+#if !defined(SIMD_X86)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+#endif
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace Simd
+{
+   enum class Level
+   {
+      Scalar = 0,
+      SSE2 = 1,
+      AVX2 = 2,
+      AVX512 = 3
+   };
+
+   // The table of kernels for one instruction set.
+   struct Kernels
+   {
+      Level level;
+
+      // Replaces whitespace characters (as std::isspace in the "C" locale)
+      // in [str, str + length) with **replacement**.
+      void (*ReplaceWhitespace)(char* str, size_t length, char replacement);
+
+      // Parses an integer: an optional '-' followed by digits, up to the
+      // first non-digit. Returns the end of the number, or nullptr if
+      // there are no digits or the number does not fit into int.
+      // The AVX2 and AVX-512 tables use the SSE2 version: a number that
+      // fits into int has at most 10 digits, so wider vectors do not help.
+      const char* (*ParseInt)(const char* first, const char* last, int& value);
+
+      // The max-plus DP step: dst[i] = max(a[i], b[i] + add) for i < count.
+      // dst may be the same array as a; b[i] + add must not overflow. The
+      // shifted form dst[i] = max(a[i], a[i - s] + add) for s <= i < count,
+      // e.g., a 0/1 knapsack row computed from the previous row a, is
+      // MaxPlusStep(dst + s, a + s, a, add, count - s). The cells of a row
+      // of a tiled_table tile are contiguous, so the step also updates the
+      // tile rows visited by for_each_wavefront.
+      void (*MaxPlusStep)(int* dst, const int* a, const int* b, int add, size_t count);
+
+      // Checks that [str, str + length) contains only digits, commas, '-'
+      // and whitespace, and counts the commas. Returns false if there are
+      // other characters.
+      bool (*ScanIntList)(const char* str, size_t length, size_t& commaCount);
+
+      // Writes the offsets of the commas in [str, str + length), which
+      // must be less than 2^32, to **positions**.
+      void (*FindCommas)(const char* str, size_t length, uint32_t* positions);
+   };
+
+   inline const char* GetLevelName(Level level)
+   {
+      switch (level)
+      {
+         case Level::SSE2:   return "sse2";
+         case Level::AVX2:   return "avx2";
+         case Level::AVX512: return "avx512";
+         default:            return "scalar";
+      }
+   }
+
+   // The best instruction set supported by the CPU and the OS.
+   inline Level DetectLevel()
+   {
+#if SIMD_X86
+      __builtin_cpu_init();
+
+      // every CPU with AVX2 has POPCNT; check it anyway
+      bool bPopcnt = __builtin_cpu_supports("popcnt");
+
+      if (bPopcnt && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+      {
+         return Level::AVX512;
+      }
+
+      if (bPopcnt && __builtin_cpu_supports("avx2")) return Level::AVX2;
+      if (__builtin_cpu_supports("sse2")) return Level::SSE2;
+#endif
+      return Level::Scalar;
+   }
+
+   namespace Scalar
+   {
+      inline bool IsWhitespace(char c)
+      {
+         return (c == ' ') || (static_cast<unsigned char>(c - '\t') <= '\r' - '\t');
+      }
+
+      inline bool IsDigit(char c)
+      {
+         return static_cast<unsigned char>(c - '0') <= 9;
+      }
+
+      inline void ReplaceWhitespace(char* str, size_t length, char replacement)
+      {
+         for (size_t i = 0; i < length; i++)
+         {
+            if (IsWhitespace(str[i])) str[i] = replacement;
+         }
+      }
+
+      // Converts **count** digits; checks for overflow once per number.
+      inline const char* ConvertDigits(const char* first, size_t count, bool bNegative, int& value)
+      {
+         // numbers with more than 18 digits may overflow uint64_t;
+         // they still fit into int if they have leading zeros
+         while ((count > 10) && (*first == '0'))
+         {
+            first++;
+            count--;
+         }
+
+         if ((count == 0) || (count > 10)) return nullptr;
+
+         uint64_t result = 0;
+         for (size_t i = 0; i < count; i++) result = 10 * result + (first[i] - '0');
+
+         uint64_t limit = uint64_t(std::numeric_limits<int>::max()) + (bNegative ? 1 : 0);
+         if (result > limit) return nullptr;
+
+         value = bNegative ? static_cast<int>(-static_cast<int64_t>(result)) : static_cast<int>(result);
+         return first + count;
+      }
+
+      inline const char* ParseInt(const char* first, const char* last, int& value)
+      {
+         bool bNegative = (first != last) && (*first == '-');
+         if (bNegative) first++;
+
+         const char* p = first;
+         while ((p != last) && IsDigit(*p)) p++;
+
+         if (p == first) return nullptr;
+         return ConvertDigits(first, p - first, bNegative, value);
+      }
+
+      inline void MaxPlusStep(int* dst, const int* a, const int* b, int add, size_t count)
+      {
+         for (size_t i = 0; i < count; i++)
+         {
+            int candidate = b[i] + add;
+            dst[i] = (a[i] < candidate) ? candidate : a[i];
+         }
+      }
+
+      inline bool ScanIntList(const char* str, size_t length, size_t& commaCount)
+      {
+         for (size_t i = 0; i < length; i++)
+         {
+            char c = str[i];
+            if (c == ',') commaCount++;
+            else if (!IsDigit(c) && (c != '-') && !IsWhitespace(c)) return false;
+         }
+
+         return true;
+      }
+
+      // Writes offset + the indices of the set bits of **mask**.
+      inline uint32_t* WritePositions(uint64_t mask, size_t offset, uint32_t* positions)
+      {
+         for (; mask != 0; mask &= mask - 1)
+         {
+            *positions++ = static_cast<uint32_t>(offset + __builtin_ctzll(mask));
+         }
+
+         return positions;
+      }
+
+      inline void FindCommas(const char* str, size_t length, uint32_t* positions)
+      {
+         for (size_t i = 0; i < length; i++)
+         {
+            if (str[i] == ',') *positions++ = static_cast<uint32_t>(i);
+         }
+      }
+
+      // Loads the next (up to) 8 characters into a word, the first one
+      // into the lowest byte. Characters at or past **last** are zero.
+      inline uint64_t LoadWord(const char* p, const char* last)
+      {
+         uint64_t word = 0;
+         // a constant size lets the compiler emit a single load
+         if (last - p >= 8) std::memcpy(&word, p, 8);
+         else if (p < last) std::memcpy(&word, p, static_cast<size_t>(last - p));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+         word = __builtin_bswap64(word);
+#endif
+         return word;
+      }
+
+      // The number of digits at the start of a word. Only for words that
+      // passed ScanIntList: digits are then the only bytes >= '0', and
+      // adding 0x50 sets the high bit of exactly these bytes.
+      inline unsigned CountDigits(uint64_t word)
+      {
+         uint64_t nonDigits = ~(word + 0x5050505050505050ull) & 0x8080808080808080ull;
+         return (nonDigits == 0) ? 8 : (__builtin_ctzll(nonDigits) / 8);
+      }
+
+      // Converts the first **count** (1 to 8) digits of a word with three
+      // SWAR multiply-adds: pairs of digits, then groups of four, then all.
+      inline uint32_t ConvertDigits(uint64_t word, unsigned count)
+      {
+         // the digits move to the top bytes; the zero bytes shifted in act
+         // as leading zeros
+         word = (word - 0x3030303030303030ull) << (8 * (8 - count));
+         word = (word * 10) + (word >> 8);
+         word = (((word & 0x000000ff000000ffull) * (100 + (1000000ull << 32))) +
+                 (((word >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32)))) >> 32;
+         return static_cast<uint32_t>(word);
+      }
+   }
+
+#if SIMD_X86
+   namespace SSE2
+   {
+      // 0xff in the bytes of x that are in ['lo', 'lo' + width]
+      __attribute__((target("sse2")))
+      inline __m128i InRange(__m128i x, char lo, char width)
+      {
+         __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+         return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(width)), shifted);
+      }
+
+      __attribute__((target("sse2")))
+      inline void ReplaceWhitespace(char* str, size_t length, char replacement)
+      {
+         const __m128i vSpace = _mm_set1_epi8(' ');
+         const __m128i vReplacement = _mm_set1_epi8(replacement);
+         size_t i = 0;
+
+         for (; i + 16 <= length; i += 16)
+         {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+            __m128i mask = _mm_or_si128(_mm_cmpeq_epi8(x, vSpace), InRange(x, '\t', '\r' - '\t'));
+            x = _mm_or_si128(_mm_and_si128(mask, vReplacement), _mm_andnot_si128(mask, x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(str + i), x);
+         }
+
+         Scalar::ReplaceWhitespace(str + i, length - i, replacement);
+      }
+
+      // Finds the end of the digits with one comparison per 16 bytes.
+      // Wider vectors do not help here: numbers that fit into int are
+      // at most 10 digits long.
+      __attribute__((target("sse2")))
+      inline const char* ParseInt(const char* first, const char* last, int& value)
+      {
+         bool bNegative = (first != last) && (*first == '-');
+         if (bNegative) first++;
+
+         const char* p = first;
+         while (last - p >= 16)
+         {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned digits = _mm_movemask_epi8(InRange(x, '0', 9));
+
+            if (digits != 0xffff)
+            {
+               p += __builtin_ctz(~digits);
+               break;
+            }
+
+            p += 16;
+         }
+
+         if (last - p < 16)
+         {
+            while ((p != last) && Scalar::IsDigit(*p)) p++;
+         }
+
+         if (p == first) return nullptr;
+         return Scalar::ConvertDigits(first, p - first, bNegative, value);
+      }
+
+      __attribute__((target("sse2")))
+      inline void MaxPlusStep(int* dst, const int* a, const int* b, int add, size_t count)
+      {
+         const __m128i vAdd = _mm_set1_epi32(add);
+         size_t i = 0;
+
+         // SSE2 has no _mm_max_epi32: select with a comparison mask
+         for (; i + 4 <= count; i += 4)
+         {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)), vAdd);
+            __m128i greater = _mm_cmpgt_epi32(vb, va);
+            __m128i result = _mm_or_si128(_mm_and_si128(greater, vb), _mm_andnot_si128(greater, va));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+         }
+
+         Scalar::MaxPlusStep(dst + i, a + i, b + i, add, count - i);
+      }
+
+      __attribute__((target("sse2")))
+      inline bool ScanIntList(const char* str, size_t length, size_t& commaCount)
+      {
+         const __m128i vComma = _mm_set1_epi8(',');
+         const __m128i vSpace = _mm_set1_epi8(' ');
+         size_t i = 0;
+
+         for (; i + 16 <= length; i += 16)
+         {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+            // ',' and '-' are adjacent
+            __m128i valid = _mm_or_si128(_mm_or_si128(InRange(x, '0', 9), InRange(x, ',', 1)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(x, vSpace), InRange(x, '\t', '\r' - '\t')));
+
+            if (_mm_movemask_epi8(valid) != 0xffff) return false;
+            commaCount += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(x, vComma)));
+         }
+
+         return Scalar::ScanIntList(str + i, length - i, commaCount);
+      }
+
+      __attribute__((target("sse2")))
+      inline void FindCommas(const char* str, size_t length, uint32_t* positions)
+      {
+         const __m128i vComma = _mm_set1_epi8(',');
+         size_t i = 0;
+
+         for (; i + 16 <= length; i += 16)
+         {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+            positions = Scalar::WritePositions(_mm_movemask_epi8(_mm_cmpeq_epi8(x, vComma)), i, positions);
+         }
+
+         for (; i < length; i++)
+         {
+            if (str[i] == ',') *positions++ = static_cast<uint32_t>(i);
+         }
+      }
+   }
+
+   namespace AVX2
+   {
+      __attribute__((target("avx2")))
+      inline void ReplaceWhitespace(char* str, size_t length, char replacement)
+      {
+         const __m256i vSpace = _mm256_set1_epi8(' ');
+         const __m256i vTab = _mm256_set1_epi8('\t');
+         const __m256i vWidth = _mm256_set1_epi8('\r' - '\t');
+         const __m256i vReplacement = _mm256_set1_epi8(replacement);
+         size_t i = 0;
+
+         for (; i + 32 <= length; i += 32)
+         {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+            __m256i shifted = _mm256_sub_epi8(x, vTab);
+            __m256i mask = _mm256_or_si256(_mm256_cmpeq_epi8(x, vSpace),
+                              _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, vWidth), shifted));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(str + i),
+                                _mm256_blendv_epi8(x, vReplacement, mask));
+         }
+
+         SSE2::ReplaceWhitespace(str + i, length - i, replacement);
+      }
+
+      __attribute__((target("avx2")))
+      inline void MaxPlusStep(int* dst, const int* a, const int* b, int add, size_t count)
+      {
+         const __m256i vAdd = _mm256_set1_epi32(add);
+         size_t i = 0;
+
+         for (; i + 8 <= count; i += 8)
+         {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                                _mm256_max_epi32(va, _mm256_add_epi32(vb, vAdd)));
+         }
+
+         Scalar::MaxPlusStep(dst + i, a + i, b + i, add, count - i);
+      }
+
+      // 0xff in the bytes of x that are in ['lo', 'lo' + width]
+      __attribute__((target("avx2")))
+      inline __m256i InRange(__m256i x, char lo, char width)
+      {
+         __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+         return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(width)), shifted);
+      }
+
+      __attribute__((target("avx2,popcnt")))
+      inline bool ScanIntList(const char* str, size_t length, size_t& commaCount)
+      {
+         const __m256i vComma = _mm256_set1_epi8(',');
+         const __m256i vSpace = _mm256_set1_epi8(' ');
+         size_t i = 0;
+
+         for (; i + 32 <= length; i += 32)
+         {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+            __m256i valid = _mm256_or_si256(_mm256_or_si256(InRange(x, '0', 9), InRange(x, ',', 1)),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(x, vSpace), InRange(x, '\t', '\r' - '\t')));
+
+            if (static_cast<unsigned>(_mm256_movemask_epi8(valid)) != 0xffffffffu) return false;
+            commaCount += _mm_popcnt_u32(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, vComma))));
+         }
+
+         return SSE2::ScanIntList(str + i, length - i, commaCount);
+      }
+
+      __attribute__((target("avx2")))
+      inline void FindCommas(const char* str, size_t length, uint32_t* positions)
+      {
+         const __m256i vComma = _mm256_set1_epi8(',');
+         size_t i = 0;
+
+         for (; i + 64 <= length; i += 64)
+         {
+            __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+            __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i + 32));
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x0, vComma))) |
+                            (uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x1, vComma)))) << 32);
+            positions = Scalar::WritePositions(mask, i, positions);
+         }
+
+         for (; i < length; i++)
+         {
+            if (str[i] == ',') *positions++ = static_cast<uint32_t>(i);
+         }
+      }
+   }
+
+   namespace AVX512
+   {
+      // AVX-512 handles the tails with masked loads and stores.
+      __attribute__((target("avx512f,avx512bw")))
+      inline void ReplaceWhitespace(char* str, size_t length, char replacement)
+      {
+         const __m512i vSpace = _mm512_set1_epi8(' ');
+         const __m512i vTab = _mm512_set1_epi8('\t');
+         const __m512i vWidth = _mm512_set1_epi8('\r' - '\t');
+         const __m512i vReplacement = _mm512_set1_epi8(replacement);
+
+         for (size_t i = 0; i < length; i += 64)
+         {
+            __mmask64 live = (length - i >= 64) ? ~__mmask64(0) : ((__mmask64(1) << (length - i)) - 1);
+            __m512i x = _mm512_maskz_loadu_epi8(live, str + i);
+            __mmask64 mask = _mm512_cmpeq_epi8_mask(x, vSpace) |
+                             _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, vTab), vWidth);
+            _mm512_mask_storeu_epi8(str + i, mask & live, vReplacement);
+         }
+      }
+
+      __attribute__((target("avx512f")))
+      inline void MaxPlusStep(int* dst, const int* a, const int* b, int add, size_t count)
+      {
+         const __m512i vAdd = _mm512_set1_epi32(add);
+
+         for (size_t i = 0; i < count; i += 16)
+         {
+            __mmask16 live = (count - i >= 16) ? __mmask16(0xffff) : __mmask16((1u << (count - i)) - 1);
+            __m512i va = _mm512_maskz_loadu_epi32(live, a + i);
+            __m512i vb = _mm512_maskz_loadu_epi32(live, b + i);
+            _mm512_mask_storeu_epi32(dst + i, live, _mm512_maskz_max_epi32(live, va, _mm512_add_epi32(vb, vAdd)));
+         }
+      }
+
+      __attribute__((target("avx512f,avx512bw,popcnt")))
+      inline bool ScanIntList(const char* str, size_t length, size_t& commaCount)
+      {
+         const __m512i vComma = _mm512_set1_epi8(',');
+         const __m512i vSpace = _mm512_set1_epi8(' ');
+         const __m512i vZero = _mm512_set1_epi8('0');
+         const __m512i vNine = _mm512_set1_epi8(9);
+         const __m512i vTab = _mm512_set1_epi8('\t');
+         const __m512i vWidth = _mm512_set1_epi8('\r' - '\t');
+
+         for (size_t i = 0; i < length; i += 64)
+         {
+            __mmask64 live = (length - i >= 64) ? ~__mmask64(0) : ((__mmask64(1) << (length - i)) - 1);
+            __m512i x = _mm512_maskz_loadu_epi8(live, str + i);
+            __mmask64 comma = _mm512_cmpeq_epi8_mask(x, vComma);
+            __mmask64 valid = comma |
+                              _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, vZero), vNine) |
+                              _mm512_cmpeq_epi8_mask(x, _mm512_set1_epi8('-')) |
+                              _mm512_cmpeq_epi8_mask(x, vSpace) |
+                              _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, vTab), vWidth);
+
+            if ((valid & live) != live) return false;
+            commaCount += _mm_popcnt_u64(comma & live);
+         }
+
+         return true;
+      }
+
+      __attribute__((target("avx512f,avx512bw")))
+      inline void FindCommas(const char* str, size_t length, uint32_t* positions)
+      {
+         const __m512i vComma = _mm512_set1_epi8(',');
+
+         for (size_t i = 0; i < length; i += 64)
+         {
+            __mmask64 live = (length - i >= 64) ? ~__mmask64(0) : ((__mmask64(1) << (length - i)) - 1);
+            __m512i x = _mm512_maskz_loadu_epi8(live, str + i);
+            positions = Scalar::WritePositions(_mm512_cmpeq_epi8_mask(x, vComma) & live, i, positions);
+         }
+      }
+   }
+#endif
+
+   inline const Kernels& GetKernels(Level level)
+   {
+      static const Kernels scalar = {Level::Scalar, Scalar::ReplaceWhitespace,
+                                     Scalar::ParseInt, Scalar::MaxPlusStep,
+                                     Scalar::ScanIntList, Scalar::FindCommas};
+#if SIMD_X86
+      static const Kernels sse2 = {Level::SSE2, SSE2::ReplaceWhitespace,
+                                   SSE2::ParseInt, SSE2::MaxPlusStep,
+                                   SSE2::ScanIntList, SSE2::FindCommas};
+      static const Kernels avx2 = {Level::AVX2, AVX2::ReplaceWhitespace,
+                                   SSE2::ParseInt, AVX2::MaxPlusStep,
+                                   AVX2::ScanIntList, AVX2::FindCommas};
+      static const Kernels avx512 = {Level::AVX512, AVX512::ReplaceWhitespace,
+                                     SSE2::ParseInt, AVX512::MaxPlusStep,
+                                     AVX512::ScanIntList, AVX512::FindCommas};
+
+      switch (level)
+      {
+         case Level::SSE2:   return sse2;
+         case Level::AVX2:   return avx2;
+         case Level::AVX512: return avx512;
+         default:            return scalar;
+      }
+#else
+      (void) level;
+      return scalar;
+#endif
+   }
+
+   // The detected level, limited by the SIMD_LEVEL environment variable.
+   inline Level SelectLevel()
+   {
+      Level level = DetectLevel();
+      const char* requested = std::getenv("SIMD_LEVEL");
+
+      if (requested != nullptr)
+      {
+         for (Level l : {Level::Scalar, Level::SSE2, Level::AVX2, Level::AVX512})
+         {
+            if ((std::strcmp(requested, GetLevelName(l)) == 0) && (l < level)) level = l;
+         }
+      }
+
+      return level;
+   }
+
+   // The kernels chosen for this CPU. The choice is made once.
+   inline const Kernels& Dispatch()
+   {
+      static const Kernels& kernels = GetKernels(SelectLevel());
+      return kernels;
+   }
+
+   inline void ReplaceWhitespace(char* str, size_t length, char replacement)
+   {
+      Dispatch().ReplaceWhitespace(str, length, replacement);
+   }
+
+   inline const char* ParseInt(const char* first, const char* last, int& value)
+   {
+      return Dispatch().ParseInt(first, last, value);
+   }
+
+   inline void MaxPlusStep(int* dst, const int* a, const int* b, int add, size_t count)
+   {
+      Dispatch().MaxPlusStep(dst, a, b, add, count);
+   }
+
+   // Parses a comma-separated list of integers, e.g., "1, -2, 3", into
+   // **result**. Elements may be surrounded by whitespace. Empty elements,
+   // '+' signs and numbers that do not fit into int are errors; on errors
+   // the function returns false and the contents of **result** are
+   // unspecified.
+   //
+   // The dispatched kernels check the characters, count the commas and
+   // write their positions into the result. The elements are then parsed
+   // independently of each other, so the CPU can overlap them: each one
+   // is converted 8 digits at a time, with one overflow check per number,
+   // and overwrites the position it was found by.
+   inline bool ParseIntList(const char* first, const char* last, std::vector<int>& result)
+   {
+      size_t length = last - first;
+      size_t commaCount = 0;
+
+      if (length > std::numeric_limits<uint32_t>::max()) return false;
+      if (!Dispatch().ScanIntList(first, length, commaCount)) return false;
+
+      result.resize(commaCount + 1);
+      uint32_t* positions = reinterpret_cast<uint32_t*>(result.data());
+      Dispatch().FindCommas(first, length, positions);
+      positions[commaCount] = static_cast<uint32_t>(length);
+
+      const char* begin = first;
+
+      for (size_t i = 0; i <= commaCount; i++)
+      {
+         const char* end = first + positions[i];
+         const char* p = begin;
+         begin = end + 1;
+
+         while ((p != end) && Scalar::IsWhitespace(*p)) p++;
+
+         bool bNegative = (p != end) && (*p == '-');
+         p += bNegative;
+
+         // an int has at most 10 digits: up to 8 in the first word and,
+         // only if the first word is all digits, up to 2 in the second;
+         // the digits end at the comma, so the words may extend past it
+         uint64_t low = 0;
+         uint64_t high = 0;
+
+         if (last - p >= 16)
+         {
+            low = Scalar::LoadWord(p, p + 8);
+            high = Scalar::LoadWord(p + 8, p + 16);
+         }
+         else
+         {
+            low = Scalar::LoadWord(p, last);
+            if (last - p > 8) high = Scalar::LoadWord(p + 8, last);
+         }
+
+         unsigned lowCount = Scalar::CountDigits(low);
+         if (lowCount == 0) return false;
+
+         unsigned highCount = 0;
+         if (lowCount == 8) highCount = Scalar::CountDigits(high);
+
+         int value = 0;
+
+         if (highCount > 2)
+         {
+            // more than 10 digits fit into int only with leading zeros
+            const char* digits = p;
+            while ((p != end) && Scalar::IsDigit(*p)) p++;
+            if (Scalar::ConvertDigits(digits, p - digits, bNegative, value) == nullptr) return false;
+         }
+         else
+         {
+            uint64_t number = Scalar::ConvertDigits(low, lowCount);
+            if (highCount > 0) number = number * ((highCount == 1) ? 10 : 100) + Scalar::ConvertDigits(high, highCount);
+            p += lowCount + highCount;
+
+            uint64_t limit = uint64_t(std::numeric_limits<int>::max()) + (bNegative ? 1 : 0);
+            if (number > limit) return false;
+
+            value = bNegative ? static_cast<int>(-static_cast<int64_t>(number)) : static_cast<int>(number);
+         }
+
+         while ((p != end) && Scalar::IsWhitespace(*p)) p++;
+         if (p != end) return false;
+
+         result[i] = value;
+      }
+
+      return true;
+   }
+}
+
+#endif //_simd_h_
@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////
+// Comparison of solver variants.
+//
+// Variants of a solver register by name in the Registry of their
+// problem type. Run solves the same problems with every variant: the
+// variants run in a new random order in every round, so slow drifts of
+// the machine (frequency, other processes) affect all of them alike,
+// and the caches can be flushed before every run. The report gives the
+// median time of every variant with a 95% confidence interval, the
+// speedup over the first variant (the baseline), and the variants
+// whose answers differ from the answers of the baseline.
+//
+// Example:
+//   SolverBenchmark::RegisterSolver<Problem>("bottom-up", SolveBottomUp);
+//   SolverBenchmark::RegisterSolver<Problem>("top-down", SolveTopDown);
+//   auto results = SolverBenchmark::Run(SolverBenchmark::Registry<Problem>::Global(), problems);
+//   SolverBenchmark::PrintResults(std::cout, results);
+//
+
+#ifndef _solver_benchmark_h_
+#define _solver_benchmark_h_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace SolverBenchmark
+{
+   template<class Problem>
+   class Registry
+   {
+   public:
+      typedef std::function<int(const Problem& problem)> Solver;
+
+      struct Variant
+      {
+         std::string name;
+         Solver solve;
+      };
+
+   public:
+      // Returns false if a variant with the name is registered already.
+      bool Add(const std::string& name, Solver solve);
+
+      const std::vector<Variant>& GetVariants() const;
+
+      // The registry that RegisterSolver adds to.
+      static Registry& Global();
+
+   private:
+      std::vector<Variant> variants;
+   };
+
+   // Adds a variant to the global registry of **Problem**; returns a
+   // value so that it can initialize a static variable.
+   template<class Problem>
+   bool RegisterSolver(const std::string& name, typename Registry<Problem>::Solver solve);
+
+   struct Options
+   {
+      int warmupRounds = 1;
+      int rounds = 15;
+
+      // Caches are flushed by writing a buffer of **flushBytes** bytes.
+      bool bFlushCache = false;
+      size_t flushBytes = size_t(64) << 20;
+
+      uint64_t seed = 1;
+   };
+
+   struct VariantResult
+   {
+      std::string name;
+
+      // milliseconds per run over all problems, sorted
+      std::vector<double> times;
+      double median = 0;
+      double low = 0;
+      double high = 0;
+
+      // the problems where the answer differs from the baseline
+      size_t disagreements = 0;
+      size_t firstDisagreement = 0;
+   };
+
+   // The results in the order the variants were registered.
+   template<class Problem>
+   std::vector<VariantResult> Run(const Registry<Problem>& registry,
+                                  const std::vector<Problem>& problems,
+                                  const Options& options = Options());
+
+   inline void PrintResults(std::ostream& out, const std::vector<VariantResult>& results);
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   template<class Problem>
+   bool Registry<Problem>::Add(const std::string& name, Solver solve)
+   {
+      for (const Variant& variant : variants)
+      {
+         if (variant.name == name) return false;
+      }
+
+      variants.push_back({name, std::move(solve)});
+      return true;
+   }
+
+   template<class Problem>
+   const std::vector<typename Registry<Problem>::Variant>& Registry<Problem>::GetVariants() const
+   {
+      return variants;
+   }
+
+   template<class Problem>
+   Registry<Problem>& Registry<Problem>::Global()
+   {
+      static Registry registry;
+      return registry;
+   }
+
+   template<class Problem>
+   bool RegisterSolver(const std::string& name, typename Registry<Problem>::Solver solve)
+   {
+      return Registry<Problem>::Global().Add(name, std::move(solve));
+   }
+
+   // Writes and reads a buffer larger than the caches; the sum keeps
+   // the compiler from removing the loop.
+   inline void FlushCaches(size_t bytes)
+   {
+      static std::vector<uint64_t> buffer;
+      static volatile uint64_t sink = 0;
+
+      buffer.resize(bytes / sizeof(uint64_t));
+
+      uint64_t sum = 0;
+      for (size_t i = 0; i < buffer.size(); i++)
+      {
+         buffer[i] += i;
+         sum += buffer[i];
+      }
+
+      sink = sink + sum;
+   }
+
+   // The median and the ranks n/2 -+ 0.98 sqrt(n) of the sorted times:
+   // a distribution-free 95% confidence interval of the median.
+   inline void SetMedianInterval(VariantResult& result)
+   {
+      std::vector<double>& times = result.times;
+      if (times.empty()) return;
+
+      std::sort(times.begin(), times.end());
+
+      size_t n = times.size();
+      double halfWidth = 0.98 * std::sqrt(static_cast<double>(n));
+      long lowRank = std::lround(n / 2.0 - halfWidth);
+      long highRank = std::lround(1 + n / 2.0 + halfWidth);
+
+      result.median = (n % 2 == 1) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+      result.low = times[std::max(lowRank, 1L) - 1];
+      result.high = times[std::min(static_cast<size_t>(std::max(highRank, 1L)), n) - 1];
+   }
+
+   template<class Problem>
+   std::vector<VariantResult> Run(const Registry<Problem>& registry,
+                                  const std::vector<Problem>& problems,
+                                  const Options& options)
+   {
+      typedef std::chrono::steady_clock Clock;
+
+      const auto& variants = registry.GetVariants();
+      size_t nVariants = variants.size();
+
+      std::vector<VariantResult> results(nVariants);
+      std::vector<std::vector<int>> answers(nVariants, std::vector<int>(problems.size()));
+
+      std::vector<size_t> order(nVariants);
+      std::iota(order.begin(), order.end(), 0);
+      std::mt19937_64 random(options.seed);
+
+      for (int round = 0; round < options.warmupRounds + options.rounds; round++)
+      {
+         std::shuffle(order.begin(), order.end(), random);
+
+         for (size_t v : order)
+         {
+            if (options.bFlushCache) FlushCaches(options.flushBytes);
+
+            std::vector<int>& variantAnswers = answers[v];
+            const auto& solve = variants[v].solve;
+
+            Clock::time_point tStart = Clock::now();
+
+            for (size_t i = 0; i < problems.size(); i++)
+            {
+               variantAnswers[i] = solve(problems[i]);
+            }
+
+            Clock::time_point tEnd = Clock::now();
+
+            if (round >= options.warmupRounds)
+            {
+               results[v].times.push_back(std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+            }
+         }
+      }
+
+      for (size_t v = 0; v < nVariants; v++)
+      {
+         results[v].name = variants[v].name;
+         SetMedianInterval(results[v]);
+
+         for (size_t i = 0; i < problems.size(); i++)
+         {
+            if (answers[v][i] != answers[0][i])
+            {
+               if (results[v].disagreements == 0) results[v].firstDisagreement = i;
+               results[v].disagreements++;
+            }
+         }
+      }
+
+      return results;
+   }
+
+   // Speedups are the ratios of the medians; their intervals combine the
+   // opposite ends of the intervals of the medians.
+   inline void PrintResults(std::ostream& out, const std::vector<VariantResult>& results)
+   {
+      if (results.empty())
+      {
+         out << "No solver variants are registered." << std::endl;
+         return;
+      }
+
+      const VariantResult& baseline = results[0];
+
+      std::ios::fmtflags flags = out.flags();
+      std::streamsize precision = out.precision();
+      out << std::setprecision(4);
+
+      out << std::endl << "Solver variants (" << baseline.times.size()
+          << " interleaved run(s) each; median and 95% confidence interval):" << std::endl;
+
+      for (const VariantResult& result : results)
+      {
+         out << "  " << result.name << ": " << result.median << "ms ["
+             << result.low << ", " << result.high << "]";
+
+         if (&result == &baseline)
+         {
+            out << ", baseline";
+         }
+         else if ((result.median > 0) && (result.low > 0))
+         {
+            out << ", speedup " << baseline.median / result.median << "x ["
+                << baseline.low / result.high << ", " << baseline.high / result.low << "]";
+         }
+
+         if (result.disagreements > 0)
+         {
+            out << std::endl << "    ANSWERS DIFFER from " << baseline.name << " in "
+                << result.disagreements << " problem(s), first: problem #"
+                << (result.firstDisagreement + 1);
+         }
+
+         out << std::endl;
+      }
+
+      out.flags(flags);
+      out.precision(precision);
+   }
+}
+
+#endif //_solver_benchmark_h_
@@ -8,19 +8,47 @@
 #define _test_framework_h_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <charconv>
 #include <chrono>
 #include <climits>
 #include <cmath>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "concise.h"
+#include "sampling_profiler.h"
+#include "simd.h"
+#include "trace.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TEST_FRAMEWORK_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define TEST_FRAMEWORK_HAS_MMAP 0
+#endif
+
 namespace TestFramework
 {
    constexpr int GetTestFrameworkVersion ()
@@ -28,6 +56,16 @@ namespace TestFramework
       return 107;
    }
 
+   // The workers of alg::thread_pool, like the threads of the framework,
+   // make their stacks known to the sampling profiler.
+   bool RegisterPoolThreadsWithProfiler()
+   {
+      alg::thread_pool::set_thread_start_hook(Profiler::RegisterThread);
+      return true;
+   }
+
+   const bool bPoolThreadsRegistered = RegisterPoolThreadsWithProfiler();
+
    void ExitIfConditionFails(bool bCondition, const char* error)
    {
       if (!bCondition)
@@ -51,16 +89,21 @@ namespace TestFramework
       }
    }
 
+   // A range of characters in a string or in a memory-mapped file.
+   // StringSegment does not own the characters.
    class StringSegment
    {
    public:
       StringSegment(const std::string& s);
+      StringSegment(const char* data, size_t length);
 
       void CopyTo(std::string& dest) const;
       bool CopyTo(char* buffer, size_t buffer_size) const;
 
       size_t CountChars(char c) const;
 
+      const char* Data() const;
+
       bool IsEmpty() const;
       size_t Length() const;
 
@@ -87,7 +130,64 @@ namespace TestFramework
    private:
       size_t iBegin;
       size_t iEnd;
-      const std::string& str;
+      const char* str;
+   };
+
+   // An output stream with a large user-space buffer: values are formatted
+   // directly into the buffer, which goes to the stream in big writes.
+   // The buffer is flushed when it is full and on destruction. It is
+   // not initialized; writers of single records use kRecordCapacity.
+   class OutputBuffer
+   {
+   public:
+      static constexpr size_t kDefaultCapacity = 1 << 20;
+      static constexpr size_t kRecordCapacity = 1 << 12;
+
+   public:
+      OutputBuffer(std::ostream& out, size_t capacity = kDefaultCapacity);
+      ~OutputBuffer();
+
+      OutputBuffer(const OutputBuffer&) = delete;
+      OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+      void Append(char c);
+      void Append(const char* str);
+      void Append(const char* str, size_t length);
+      void Append(const std::string& str);
+      void AppendInt(int value);
+
+      void Flush();
+
+   private:
+      std::ostream& out;
+      size_t capacity;
+      std::unique_ptr<char[]> buffer;
+      size_t size;
+   };
+
+   // A read-only memory mapping of a file. IsOpen() is false if the file
+   // cannot be opened or mapped (or mmap is not available).
+   class MappedFile
+   {
+   public:
+      MappedFile(const char* filename);
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      bool IsOpen() const;
+      const char* Data() const;
+      size_t Size() const;
+
+      // The modification time in nanoseconds.
+      int64_t ModificationTime() const;
+
+   private:
+      const char* data;
+      size_t size;
+      int64_t mtime;
+      bool isOpen;
    };
 
    class AbstractLineParser
@@ -95,23 +195,43 @@ namespace TestFramework
    public:
       AbstractLineParser();
       void ParseFile(const char* filename, bool shouldExitOnError = false);
+      void ParseBuffer(const char* data, size_t size, bool shouldExitOnError = false);
       bool IsOK() const;
 
+      // Prints the error and exits if parsing failed, as if the file had
+      // been parsed with **shouldExitOnError** set.
+      void ExitOnError();
+
    protected:
       void CheckCondition(bool bCondition, const char* error);
 
+      // Reports an error found elsewhere (e.g., by a worker parser) at **line**.
+      void ReportError(size_t line, const char* error);
+      void ClearErrors();
+
+      // Parses the lines of a buffer, continuing the line count.
+      void ParseLines(const char* data, size_t size);
+
+      size_t GetLineNumber() const;
+      const char* GetError() const;
+
    private:
       virtual void PreParse() {};
       virtual void PostParse() {};
       virtual void ParseLine(StringSegment s) = 0;
 
-   private:
-      void ClearErrors();
+      // Parses the buffer between PreParse and PostParse;
+      // parsers may override it to split the work.
+      virtual void ParseText(const char* data, size_t size);
+
+      // Parses a mapped file; parsers may override it to cache the results.
+      virtual void ParseMappedFile(const char* filename, const MappedFile& file, bool shouldExitOnError);
 
    private:
       size_t lineNumber;
       bool bExitOnError;
       bool isOK;
+      const char* error;
    };
 
    template<class T>
@@ -121,7 +241,14 @@ namespace TestFramework
       virtual bool FromString(T& var, StringSegment s) const = 0;
       virtual bool FromString(T& var, const std::string& str) const;
 
+      // Binary form of the field for the parse cache; returns false if
+      // the field type does not have one.
+      virtual bool ToBinary(const T& var, std::string& out /* appended */) const;
+      virtual bool FromBinary(T& var, const char*& p, const char* end) const;
+      virtual const char* GetBinaryType() const;
+
       virtual void ToString(const T& var, std::string& s /* out */) const = 0;
+      virtual void ToBuffer(const T& var, OutputBuffer& out) const;
 
       virtual bool EqualsDefaultValue(const T& var) const = 0;
       virtual void SetDefaultValue(T& var) const = 0;
@@ -139,6 +266,11 @@ namespace TestFramework
 
       bool FromString(T& var, StringSegment s) const override;
       void ToString(const T& var, std::string& s /* out */) const override;
+      void ToBuffer(const T& var, OutputBuffer& out) const override;
+
+      bool ToBinary(const T& var, std::string& out /* appended */) const override;
+      bool FromBinary(T& var, const char*& p, const char* end) const override;
+      const char* GetBinaryType() const override;
 
       bool EqualsDefaultValue(const T& var) const override;
       void SetDefaultValue(T& var) const override;
@@ -163,6 +295,9 @@ namespace TestFramework
       virtual bool GetValue(size_t row, StringSegment key, std::string& value) const;
       virtual bool SetValue(size_t row, StringSegment key, StringSegment value);
 
+      // Writes the value as GetValue formats it, without a temporary string.
+      virtual bool WriteValue(size_t row, size_t col, OutputBuffer& out) const;
+
       virtual bool GetColumnByName(StringSegment key, size_t& col) const = 0;
 
       virtual bool EqualsDefaultValue(size_t row, size_t col) const = 0;
@@ -170,6 +305,24 @@ namespace TestFramework
       virtual size_t ColumnCount() const = 0;
       virtual size_t RowCount() const = 0;
 
+      // Parallel parsing: a new empty table with the same columns, and
+      // moving the rows of such a table to the end of this one. Tables
+      // that do not support it return nullptr.
+      virtual std::unique_ptr<ITable> CreateSlice() const;
+      virtual void AppendSlice(ITable& slice);
+
+      // Binary form of **count** values of a column, starting at
+      // **firstRow**, for the parse cache. Return false if a field type
+      // does not have one or the data is invalid.
+      virtual bool WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out /* appended */) const;
+      virtual bool ReadColumn(size_t col, size_t firstRow, size_t count, const char*& p, const char* end);
+
+      // Name of the binary form of a column, or "" if it has none.
+      virtual const char* GetColumnType(size_t col) const;
+
+      // Called by the parser after the last row; see StreamingTable.
+      virtual void FinishRows();
+
       virtual ~ITable() {}
    };
 
@@ -188,11 +341,16 @@ namespace TestFramework
 
       bool GetValue(size_t row, size_t col, std::string& value) const override;
       bool SetValue(size_t row, size_t col, StringSegment value) override;
+      bool WriteValue(size_t row, size_t col, OutputBuffer& out) const override;
 
       bool GetColumnByName(StringSegment key, size_t& col) const override;
 
       size_t ColumnCount() const override;
 
+      bool WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out) const override;
+      bool ReadColumn(size_t col, size_t firstRow, size_t count, const char*& p, const char* end) override;
+      const char* GetColumnType(size_t col) const override;
+
       virtual ~AbstractTableAdapter(){};
    private:
       virtual T& GetRecord(size_t i) = 0;
@@ -206,7 +364,7 @@ namespace TestFramework
       };
 
    private:
-      std::map<std::string, size_t> name2id;
+      std::map<std::string, size_t, std::less<>> name2id;
       std::vector<ColumnSpec> columnSpecs;
    };
 
@@ -240,10 +398,17 @@ namespace TestFramework
    public:
       TableAdapter(std::vector<T>& data) : data(data) {};
 
+      // An adapter of **data** with the columns of **columns**.
+      TableAdapter(const TableAdapter& columns, std::vector<T>& data) :
+         AbstractTableAdapter<T>(columns), data(data) {};
+
       bool NewRow(size_t& row) override;
       bool IsFixedSize() const override;
       size_t RowCount() const override;
 
+      std::unique_ptr<ITable> CreateSlice() const override;
+      void AppendSlice(ITable& slice) override;
+
    private:
       T & GetRecord(size_t i) override;
       const T& GetRecord(size_t i) const override;
@@ -252,25 +417,58 @@ namespace TestFramework
       std::vector<T>& data;
    };
 
+   // A table adapter that owns its rows; see TableAdapter::CreateSlice.
+   template<class T>
+   class TableSlice : public TableAdapter<T>
+   {
+   public:
+      // the base class only stores the reference to **rows**
+      TableSlice(const TableAdapter<T>& columns) : TableAdapter<T>(columns, rows) {};
+
+      std::vector<T> rows;
+   };
+
    class BasicYamlParser : public AbstractLineParser
    {
    public:
       BasicYamlParser() :
          AbstractLineParser(), pHeader(nullptr),
-         pTable(nullptr), isHeaderSection(true) {};
+         pTable(nullptr), isHeaderSection(true), nThreads(0), bCacheEnabled(true) {};
 
       BasicYamlParser(ITable* pHeader, ITable* pTable);
 
       void SetHeaderAdapter(ITable* newAdapter);
       void SetTableAdapter(ITable* newAdapter);
 
+      // The number of threads parsing the data section of mapped files;
+      // 0 (the default) means one per hardware thread, 1 parses serially.
+      void SetThreadCount(size_t count);
+
+      // Parsed mapped files are cached in binary sidecar files (the name
+      // of the file + ".cache"), which later runs load instead of parsing
+      // the file if it has not changed. Enabled by default.
+      void SetCacheEnabled(bool bEnabled);
+
       void PreParse() override;
+      void PostParse() override;
       void ParseLine(StringSegment s) override;
 
    private:
+      void ParseText(const char* data, size_t size) override;
+      void ParseMappedFile(const char* filename, const MappedFile& file, bool shouldExitOnError) override;
+
+      bool ReadCache(const std::string& cacheFilename, const MappedFile& file);
+      void WriteCache(const std::string& cacheFilename, const MappedFile& file, size_t firstRow);
+
+   private:
+      // smaller data sections are not worth splitting
+      static constexpr size_t kMinChunkSize = 1 << 16;
+
       ITable* pHeader;
       ITable* pTable;
       bool isHeaderSection;
+      size_t nThreads;
+      bool bCacheEnabled;
    };
 
    struct ProblemSetHeader
@@ -290,6 +488,118 @@ namespace TestFramework
       int student_answer;
    };
 
+   // A histogram of durations in nanoseconds with log-linear buckets:
+   // every power of two is split into kSubBuckets equal buckets, so
+   // percentiles are within 1/kSubBuckets of the exact values.
+   class LatencyHistogram
+   {
+   public:
+      static constexpr int kSubBucketBits = 5;
+      static constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+
+   public:
+      LatencyHistogram();
+
+      void Add(uint64_t ns);
+      void Clear();
+
+      uint64_t Count() const;
+      uint64_t Min() const;
+      uint64_t Max() const;
+      double Mean() const;
+
+      // The smallest bucket bound such that at least **fraction** of the
+      // values are not larger; e.g., Percentile(0.99) is p99.
+      uint64_t Percentile(double fraction) const;
+
+      // Prints the counts by powers of two.
+      void Print(std::ostream& out) const;
+
+   private:
+      static size_t BucketIndex(uint64_t ns);
+      static uint64_t BucketUpperBound(size_t index);
+
+   private:
+      std::vector<uint64_t> counts;
+      uint64_t count;
+      uint64_t minValue;
+      uint64_t maxValue;
+      double sum;
+   };
+
+   struct BenchmarkOptions
+   {
+      int warmupRuns = 1;
+      int repetitions = 5;
+      bool bPrintHistogram = false;
+   };
+
+   // A splittable pseudo-random generator (SplitMix64). Split(key) gives
+   // a generator for every key, independent of the others, so a problem
+   // generated from Split(i) is the same on any thread and in any order.
+   // It can be used with the std distributions.
+   class SplitRandom
+   {
+   public:
+      typedef uint64_t result_type;
+
+   public:
+      explicit SplitRandom(uint64_t seed);
+
+      uint64_t Next();
+      SplitRandom Split(uint64_t key) const;
+
+      // Uniform in [low, high].
+      int64_t Uniform(int64_t low, int64_t high);
+
+      // Uniform in [0, 1).
+      double UniformReal();
+
+      static constexpr uint64_t min() { return 0; }
+      static constexpr uint64_t max() { return UINT64_MAX; }
+      uint64_t operator ()() { return Next(); }
+
+   private:
+      static uint64_t Mix(uint64_t z);
+
+   private:
+      uint64_t state;
+   };
+
+   // The distribution of the sizes of generated problems.
+   struct SizeDistribution
+   {
+      enum class Kind
+      {
+         Fixed,
+         Uniform,
+         LogUniform
+      };
+
+      Kind kind = Kind::Fixed;
+      size_t minSize = 0;
+      size_t maxSize = 0;
+
+      static SizeDistribution Fixed(size_t size);
+      static SizeDistribution Uniform(size_t minSize, size_t maxSize);
+
+      // Every power of two between the bounds is equally likely, so
+      // there are as many small problems as large ones.
+      static SizeDistribution LogUniform(size_t minSize, size_t maxSize);
+
+      size_t Sample(SplitRandom& random) const;
+   };
+
+   struct GeneratorOptions
+   {
+      uint64_t seed = 1;
+      size_t problemCount = 0;
+      SizeDistribution sizes;
+
+      // 0 means one thread per hardware thread.
+      size_t threadCount = 0;
+   };
+
    ///////////////////////////////////////////////////////////////////////////////
 
    size_t IntLen(int value)
@@ -312,41 +622,18 @@ namespace TestFramework
       return len;
    }
 
+   // std::to_chars converts two digits per division
    size_t IntToStrHelper(int value, std::string& result, size_t pos = 0)
    {
-      size_t len = IntLen(value);
+      char digits[16];
+      size_t len = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
 
       if (result.length() < pos + len)
       {
          result.resize(pos + len);
       }
 
-      if (value == 0)
-      {
-         result[pos] = '0';
-         return pos + 1;
-      }
-
-      int sign = 1; // '+'
-
-      if (value < 0)
-      {
-         result[pos] = '-';
-         sign = -1; // '-'
-      }
-
-      //position of the least significant digit in the string
-      size_t lsPos = pos + len - 1;
-
-      while (value != 0)
-      {
-         int nextValue = value / 10;
-         int digit = sign * (value % 10);
-         result[lsPos] = digit + '0';
-         value = nextValue;
-         lsPos--;
-      }
-
+      std::memcpy(&result[pos], digits, len);
       return (pos + len);
    }
 
@@ -401,55 +688,47 @@ namespace TestFramework
       result[pos - 1] = ']';
    }
 
-   // Parse integer values
-   bool Parse(StringSegment ssegement, int& result)
+   // Encode values directly into an output buffer
+   void Encode(int value, OutputBuffer& out)
    {
-      // if x < posOverflowGuard,  then we can append any digit to x without
-      // integer overflow.
-      // if x == posOverflowGuard, then we can append only some digits
-      // if x > posOverflowGuard,  then we can not append any digits
-      static constexpr int posOverflowGuard = std::numeric_limits<int>::max() / 10;
-      static constexpr int posLastDigitGuard = std::numeric_limits<int>::max() % 10;
-
-      // Similar thersholds for negative numbers
-      // Note: Staring with C++11, the remainder of a negative number is negative.
-      // For example, -7/3 = -2 and -7 % 3 = -1. See e.g. for details:
-      // https://en.cppreference.com/w/cpp/language/operator_arithmetic#Multiplicative_operators
+      out.AppendInt(value);
+   }
 
-      static constexpr int negOverflowGuard = std::numeric_limits<int>::min() / 10;
-      static constexpr int negLastDigitGuard = std::numeric_limits<int>::min() % 10;
+   void Encode(bool value, OutputBuffer& out)
+   {
+      out.Append(value ? "yes" : "no");
+   }
 
-      result = 0;
-      ssegement.Trim();
-      if (ssegement.IsEmpty()) return false;
+   void Encode(const std::string& value, OutputBuffer& out)
+   {
+      out.Append('"');
+      out.Append(value);
+      out.Append('"');
+   }
 
-      int sign = (ssegement.FirstChar() == '-') ? (-1) : 1;
+   void Encode(const std::vector<int>& value, OutputBuffer& out)
+   {
+      out.Append('[');
 
-      if (sign == -1)
+      for (size_t i = 0; i < value.size(); i++)
       {
-         ssegement.RemovePrefix(1);
-         if (ssegement.IsEmpty()) return false;
+         if (i != 0) out.Append(',');
+         out.AppendInt(value[i]);
       }
 
-      while (!ssegement.IsEmpty())
-      {
-         char nextChar = ssegement.ReadLeft();
-         if ((nextChar < '0') || (nextChar > '9')) return false;
-
-         // for negative numbers digit is negative or zero
-         char digit = (nextChar - '0') * sign;
-
-         if ((result > posOverflowGuard) || (result < negOverflowGuard) ||
-             ((result == posOverflowGuard) && (digit > posLastDigitGuard)) ||
-             ((result == negOverflowGuard) && (digit < negLastDigitGuard)))
-         {
-            return false;
-         }
+      out.Append(']');
+   }
 
-         result = result * 10 + digit;
-      }
+   // Parse integer values: an optional '-' followed by digits, with no
+   // other characters after the whitespace is trimmed.
+   bool Parse(StringSegment ssegement, int& result)
+   {
+      result = 0;
+      ssegement.Trim();
+      if (ssegement.IsEmpty()) return false;
 
-      return true;
+      const char* last = ssegement.Data() + ssegement.Length();
+      return Simd::ParseInt(ssegement.Data(), last, result) == last;
    }
 
    bool Parse(StringSegment ssegement, std::string& result)
@@ -490,6 +769,12 @@ namespace TestFramework
 
       if ((firstChar != '[') || (lastChar != ']')) return false;
 
+      // well-formed lists take the vectorized path; the element-by-element
+      // code below handles everything else, including empty lists and the
+      // errors, exactly as before
+      if (Simd::ParseIntList(ssegement.Data(), ssegement.Data() + ssegement.Length(), result)) return true;
+      result.clear();
+
       size_t nCount = ssegement.CountChars(',') + 1;
       result.reserve(nCount);
 
@@ -509,6 +794,86 @@ namespace TestFramework
       return noErrors;
    }
 
+   // Binary forms of the values for the parse cache. The Encode functions
+   // append to **result**; the Decode functions read at **p** and advance
+   // it, and return false if the data ends too early.
+   void EncodeBinary(int value, std::string& result)
+   {
+      result.append(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+
+   void EncodeBinary(uint64_t value, std::string& result)
+   {
+      result.append(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+
+   void EncodeBinary(bool value, std::string& result)
+   {
+      result.push_back(value ? 1 : 0);
+   }
+
+   void EncodeBinary(const std::string& value, std::string& result)
+   {
+      EncodeBinary(static_cast<uint64_t>(value.size()), result);
+      result.append(value);
+   }
+
+   void EncodeBinary(const std::vector<int>& value, std::string& result)
+   {
+      EncodeBinary(static_cast<uint64_t>(value.size()), result);
+      result.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(int));
+   }
+
+   bool DecodeBinary(const char*& p, const char* end, int& value)
+   {
+      if (end - p < static_cast<ptrdiff_t>(sizeof(value))) return false;
+      std::memcpy(&value, p, sizeof(value));
+      p += sizeof(value);
+      return true;
+   }
+
+   bool DecodeBinary(const char*& p, const char* end, uint64_t& value)
+   {
+      if (end - p < static_cast<ptrdiff_t>(sizeof(value))) return false;
+      std::memcpy(&value, p, sizeof(value));
+      p += sizeof(value);
+      return true;
+   }
+
+   bool DecodeBinary(const char*& p, const char* end, bool& value)
+   {
+      if (p == end) return false;
+      value = (*p++ != 0);
+      return true;
+   }
+
+   bool DecodeBinary(const char*& p, const char* end, std::string& value)
+   {
+      uint64_t size = 0;
+      if (!DecodeBinary(p, end, size) || (size > static_cast<uint64_t>(end - p))) return false;
+      value.assign(p, size);
+      p += size;
+      return true;
+   }
+
+   bool DecodeBinary(const char*& p, const char* end, std::vector<int>& value)
+   {
+      uint64_t size = 0;
+      if (!DecodeBinary(p, end, size) || (size > static_cast<uint64_t>(end - p) / sizeof(int))) return false;
+      value.resize(size);
+      std::memcpy(value.data(), p, size * sizeof(int));
+      p += size * sizeof(int);
+      return true;
+   }
+
+   // Names of the binary forms, stored in the parse cache next to the
+   // column names: a cache written for another field type is not used.
+   constexpr const char* BinaryTypeName(const int*) { return "int"; }
+   constexpr const char* BinaryTypeName(const uint64_t*) { return "uint64"; }
+   constexpr const char* BinaryTypeName(const bool*) { return "bool"; }
+   constexpr const char* BinaryTypeName(const std::string*) { return "string"; }
+   constexpr const char* BinaryTypeName(const std::vector<int>*) { return "vector<int>"; }
+
    ///////////////////////////////////////////////////////////////////////////////
 
    template<class T, class C>
@@ -592,719 +957,2682 @@ namespace TestFramework
       AddColumn<T, int>(prAdapter, "problem", &T::id, -1);
       AddColumn<T, int>(prAdapter, "student_answer", &T::student_answer, -1);
    }
-   ///////////////////////////////////////////////////////////////////////////////
 
-   StringSegment::StringSegment(const std::string& s) : str(s)
-   {
-      iBegin = 0;
-      iEnd = s.length();
-   }
+   ///////////////////////////////////////////////////////////////////////////////
+   // Static schemas: the columns of a table declared at compile time, e.g.,
+   //
+   //   constexpr auto kSchema = MakeSchema<Problem>(
+   //      MakeColumn<Problem>("problem", &Problem::id),
+   //      MakeColumn<Problem, std::vector<int>>("left", &Problem::left));
+   //
+   //   std::vector<Problem> problems;
+   //   StaticTableAdapter<kSchema> adapter(problems);
+   //
+   // Keys are found with a perfect hash computed at compile time, and
+   // values are parsed directly into the members, without virtual calls
+   // or shared pointers. The adapters implement ITable, so the parser,
+   // the writer and the parse cache use them like TableAdapter and
+   // RecordAdapter.
+
+   constexpr char ToLowerAscii(char c)
+   {
+      return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+   }
+
+   // A column of a static schema. Scalar columns have default values;
+   // class columns are default-constructed, as with AddColumn.
+   template<class T, class C, bool bScalar = std::is_scalar<C>::value>
+   struct StaticColumn
+   {
+      typedef C FieldType;
+
+      const char* name;
+      C T::*field;
+      C defaultValue;
 
-   void StringSegment::CopyTo(std::string& dest) const
-   {
-      dest.assign(str, iBegin, iEnd - iBegin);
-   }
+      constexpr C GetDefaultValue() const { return defaultValue; }
+   };
 
-   bool StringSegment::CopyTo(char* buffer, size_t buffer_size) const
+   template<class T, class C>
+   struct StaticColumn<T, C, false>
    {
-      assert(iBegin <= iEnd);
-      assert(buffer_size > 0);
-
-      size_t count = std::min(iEnd - iBegin, buffer_size - 1);
-
-      for (size_t i = 0; i < count; ++i)
-      {
-         buffer[i] = str[iBegin + i];
-      }
+      typedef C FieldType;
 
-      buffer[count] = 0;
+      const char* name;
+      C T::*field;
 
-      return (count == (iEnd - iBegin));
-   }
+      C GetDefaultValue() const { return C(); }
+   };
 
-   size_t StringSegment::CountChars(char c) const
+   template<class T, class C>
+   constexpr StaticColumn<T, C> MakeColumn(const char* name, C T::*field)
    {
-      return (std::count (str.begin() + iBegin, str.begin() + iEnd, c));
+      static_assert(std::is_class<C>::value, "This field must be a class.");
+      return {name, field};
    }
 
-   bool StringSegment::IsEmpty() const
+   template<class T, class C>
+   constexpr StaticColumn<T, C> MakeColumn(const char* name, C T::*field, C defaultValue)
    {
-      return (iBegin == iEnd);
+      static_assert(std::is_scalar<C>::value, "Only scalar fields have default values.");
+      return {name, field, defaultValue};
    }
 
-   size_t StringSegment::Length() const
+   template<class T>
+   constexpr StaticColumn<T, int> MakeColumn(const char* name, int T::*field, int defaultValue = -1)
    {
-      assert(iBegin <= iEnd);
-      return (iEnd - iBegin);
+      return {name, field, defaultValue};
    }
 
-   char StringSegment::ReadLeft()
+   template<class T, class... Columns>
+   class StaticSchema
    {
-      char result = 0;
-      if (iBegin < iEnd)
-      {
-         result = str[iBegin];
-         iBegin++;
-      }
+   public:
+      typedef T RecordType;
+      static constexpr size_t kColumnCount = sizeof...(Columns);
 
-      return result;
-   }
+   public:
+      constexpr StaticSchema(Columns... columns);
 
-   char StringSegment::ReadRight()
-   {
-      if (iBegin < iEnd)
-      {
-         iEnd--;
-         return str[iEnd];
-      }
+      constexpr const char* GetColumnName(size_t col) const;
 
-      return 0;
-   }
+      // The column called **key**; the case of the letters is ignored.
+      bool FindColumn(StringSegment key, size_t& col) const;
 
-   char StringSegment::FirstChar() const
-   {
-      assert(iEnd > iBegin);
-      return str[iBegin];
-   }
+      // Returns func(column) for column **col** (false if there is no
+      // such column), and calls func(column) for every column.
+      template<class F> bool VisitColumn(size_t col, F&& func) const;
+      template<class F> void ForEachColumn(F&& func) const;
 
-   char StringSegment::LastChar() const
-   {
-      assert(iEnd > iBegin);
-      return str[iEnd - 1];
-   }
+   private:
+      static_assert((kColumnCount > 0) && (kColumnCount < 255), "Invalid number of columns.");
 
-   void StringSegment::RemovePrefix(size_t count)
-   {
-      iBegin = std::min(iEnd, iBegin + count);
-   }
+      // a power of two with at least two slots per column
+      static constexpr size_t kSlotCount = (kColumnCount < 2) ? 4 :
+         (size_t(1) << (64 - __builtin_clzll(2 * kColumnCount - 1)));
+      static constexpr uint8_t kEmptySlot = 255;
 
-   void StringSegment::RemoveSuffix(size_t count)
+      static constexpr size_t GetSlot(const char* str, size_t length, uint64_t seed);
+      constexpr bool PlaceNames();
+
+      template<class F, size_t... I>
+      bool VisitColumn(size_t col, F&& func, std::index_sequence<I...>) const;
+
+   private:
+      std::tuple<Columns...> columns;
+      std::array<const char*, kColumnCount> names;
+      std::array<size_t, kColumnCount> lengths;
+      std::array<uint8_t, kSlotCount> slots;
+      uint64_t seed;
+   };
+
+   template<class T, class... Columns>
+   constexpr StaticSchema<T, Columns...> MakeSchema(Columns... columns)
    {
-      iEnd = std::max(iBegin + count, iEnd) - count;
+      return StaticSchema<T, Columns...>(columns...);
    }
 
-   void StringSegment::Trim()
+   // CRTP base of the static adapters: Derived provides GetRecord(row),
+   // NewRow, IsFixedSize and RowCount.
+   template<class Derived, const auto& kSchema>
+   class StaticAdapterBase : public ITable
    {
-      TrimLeft();
-      TrimRight();
-   }
+   public:
+      typedef typename std::decay_t<decltype(kSchema)>::RecordType DataType;
 
-   void StringSegment::TrimLeft()
-   {
-      while ((iBegin < iEnd) &&
-             (isspace(str[iBegin]) || (str[iBegin] == '\r')))
-      {
-         iBegin++;
-      }
-   }
+   public:
+      StaticAdapterBase();
 
-   void StringSegment::TrimRight()
+      void SetDefaultValues(size_t row) override;
+
+      const std::string& GetColumnName(size_t col) const override;
+
+      bool GetValue(size_t row, size_t col, std::string& value) const override;
+      bool SetValue(size_t row, size_t col, StringSegment value) override;
+      bool SetValue(size_t row, StringSegment key, StringSegment value) override;
+      bool WriteValue(size_t row, size_t col, OutputBuffer& out) const override;
+
+      bool GetColumnByName(StringSegment key, size_t& col) const override;
+
+      bool EqualsDefaultValue(size_t row, size_t col) const override;
+
+      size_t ColumnCount() const override;
+
+      bool WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out) const override;
+      bool ReadColumn(size_t col, size_t firstRow, size_t count, const char*& p, const char* end) override;
+      const char* GetColumnType(size_t col) const override;
+
+   private:
+      DataType& Record(size_t row);
+      const DataType& Record(size_t row) const;
+
+   private:
+      std::array<std::string, std::decay_t<decltype(kSchema)>::kColumnCount> columnNames;
+   };
+
+   template<const auto& kSchema>
+   class StaticTableAdapter : public StaticAdapterBase<StaticTableAdapter<kSchema>, kSchema>
    {
-      while ((iBegin < iEnd) &&
-             (isspace(str[iEnd - 1]) || (str[iEnd - 1] == '\r')))
-      {
-         iEnd--;
-      }
-   }
+   public:
+      typedef typename std::decay_t<decltype(kSchema)>::RecordType DataType;
 
-   bool StringSegment::Match(const char* pattern, bool bCaseSensitive /* = false */)
+   public:
+      StaticTableAdapter(std::vector<DataType>& data) : data(data) {};
+
+      bool NewRow(size_t& row) override;
+      bool IsFixedSize() const override;
+      size_t RowCount() const override;
+
+      std::unique_ptr<ITable> CreateSlice() const override;
+      void AppendSlice(ITable& slice) override;
+
+      DataType& GetRecord(size_t i);
+      const DataType& GetRecord(size_t i) const;
+
+   private:
+      std::vector<DataType>& data;
+   };
+
+   // A static table adapter that owns its rows; see CreateSlice.
+   template<const auto& kSchema>
+   class StaticTableSlice : public StaticTableAdapter<kSchema>
    {
-      assert(iBegin <= iEnd);
+   public:
+      // the base class only stores the reference to **rows**
+      StaticTableSlice() : StaticTableAdapter<kSchema>(rows) {};
 
-      size_t iStr = iBegin;
-      size_t iPattern = 0;
+      std::vector<typename StaticTableAdapter<kSchema>::DataType> rows;
+   };
 
-      bool bMatch = true;
-      while ((pattern[iPattern] != 0) && (iStr < iEnd) && bMatch)
-      {
-         bool bEqualChars = (pattern[iPattern] == str[iStr]);
+   template<const auto& kSchema>
+   class StaticRecordAdapter : public StaticAdapterBase<StaticRecordAdapter<kSchema>, kSchema>
+   {
+   public:
+      typedef typename std::decay_t<decltype(kSchema)>::RecordType DataType;
 
-         if (!bEqualChars)
-         {
-            if (!bCaseSensitive)
-            {
-               bEqualChars = (tolower(pattern[iPattern]) == tolower(str[iPattern]));
-            }
-            bMatch = bMatch && bEqualChars;
-         }
+   public:
+      StaticRecordAdapter(DataType& data) : data(data) {};
 
-         iStr++;
-         iPattern++;
-      }
+      bool NewRow(size_t& row) override;
+      bool IsFixedSize() const override;
+      size_t RowCount() const override;
 
-      bMatch = bMatch && (pattern[iPattern] == 0) && (iStr == iEnd);
+      DataType& GetRecord(size_t i);
+      const DataType& GetRecord(size_t i) const;
 
-      return bMatch;
-   }
+   private:
+      DataType& data;
+   };
 
-   bool StringSegment::Match(StringSegment pattern, bool bCaseSensitive /* = false */)
+   // A table adapter (TableAdapter or StaticTableAdapter) that keeps only
+   // the row being parsed: when the next row starts, and after the last
+   // one, the finished row is moved to **callback** and removed, so the
+   // memory used does not grow with the number of rows. Streaming tables
+   // are parsed serially and are not cached.
+   template<class Adapter>
+   class StreamingTable : public Adapter
    {
-      size_t len = Length();
-      if (len != pattern.Length()) return false;
+   public:
+      typedef typename Adapter::DataType DataType;
+      typedef std::function<void(DataType&& record)> Callback;
 
-      for (size_t i = 0; i < len; i++)
-      {
-         bool bEqualChars = (pattern[i] == str[i]);
+   public:
+      // the base class only stores the reference to **rows**
+      StreamingTable(Callback callback = nullptr) : Adapter(rows), callback(std::move(callback)), nRows(0) {};
 
-         if (!bEqualChars)
-         {
-            if (!bCaseSensitive)
-            {
-               bEqualChars = (tolower(pattern[i]) == tolower(str[i]));
-            }
+      void SetCallback(Callback newCallback);
 
-            if (!bEqualChars) return false;
-         }
-      }
+      bool NewRow(size_t& row) override;
+      void FinishRows() override;
 
-      return true;
-   }
+      std::unique_ptr<ITable> CreateSlice() const override;
+      bool WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out) const override;
 
-   bool StringSegment::Split(char delimiter, StringSegment& prefix)
+      // The number of rows passed to the callback.
+      size_t StreamedRowCount() const;
+
+   private:
+      void EmitRow();
+
+   private:
+      std::vector<DataType> rows;
+      Callback callback;
+      size_t nRows;
+   };
+
+   // A FIFO queue between threads with a fixed capacity: Push blocks
+   // while the queue is full, Pop blocks while it is empty and returns
+   // false once the queue is closed and empty. Values pushed after the
+   // queue is closed are dropped.
+   template<class T>
+   class BoundedQueue
    {
-      assert(this != &prefix);
+   public:
+      BoundedQueue(size_t capacity);
 
-      if (!IsEmpty())
-      {
-         size_t i = iBegin;
+      void Push(T&& value);
+      bool Pop(T& value /* out */);
 
-         while ((i < iEnd) && (str[i] != delimiter)) i++;
+      // No more values will be pushed.
+      void Close();
 
-         prefix.iBegin = iBegin;
-         prefix.iEnd = i;
-         iBegin = std::min(i + 1, iEnd);
+      // Closes the queue and drops the values in it.
+      void Cancel();
 
-         return true;
+   private:
+      std::mutex mutex;
+      std::condition_variable notFull;
+      std::condition_variable notEmpty;
+      std::deque<T> values;
+      size_t capacity;
+      bool bClosed;
+   };
+
+   template<class T, class... Columns>
+   constexpr StaticSchema<T, Columns...>::StaticSchema(Columns... columns) :
+      columns(columns...), names{columns.name...}, lengths{}, slots{}, seed(0)
+   {
+      for (size_t col = 0; col < kColumnCount; col++)
+      {
+         while (names[col][lengths[col]] != 0) lengths[col]++;
       }
-      else
+
+      // try seeds until the names hash to different slots
+      while (!PlaceNames())
       {
-         prefix.iBegin = 0;
-         prefix.iEnd = 0;
+         if (++seed == 100000) throw "Cannot build a perfect hash; are two column names equal?";
+      }
+   }
 
-         return false;
+   template<class T, class... Columns>
+   constexpr bool StaticSchema<T, Columns...>::PlaceNames()
+   {
+      for (uint8_t& slot : slots) slot = kEmptySlot;
+
+      for (size_t col = 0; col < kColumnCount; col++)
+      {
+         uint8_t& slot = slots[GetSlot(names[col], lengths[col], seed)];
+         if (slot != kEmptySlot) return false;
+         slot = static_cast<uint8_t>(col);
       }
+
+      return true;
    }
 
-   char StringSegment::operator [](size_t index) const
+   // FNV-1a of the lowercase string, started from the seed
+   template<class T, class... Columns>
+   constexpr size_t StaticSchema<T, Columns...>::GetSlot(const char* str, size_t length, uint64_t seed)
    {
-      assert(iBegin + index < iEnd);
-      return str[iBegin + index];
+      uint64_t hash = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+
+      for (size_t i = 0; i < length; i++)
+      {
+         hash = (hash ^ static_cast<unsigned char>(ToLowerAscii(str[i]))) * 0x100000001b3ull;
+      }
+
+      return static_cast<size_t>(hash ^ (hash >> 32)) & (kSlotCount - 1);
    }
 
-   template<class T>
-   bool BaseFieldAdapter<T>::FromString(T& var, const std::string& str) const
+   template<class T, class... Columns>
+   constexpr const char* StaticSchema<T, Columns...>::GetColumnName(size_t col) const
    {
-      StringSegment s(str);
-      return FromString(var, s);
+      return names[col];
    }
 
-   template<class T, class C>
-   bool FieldAdapter<T, C>::FromString(T& var, StringSegment s) const
+   template<class T, class... Columns>
+   bool StaticSchema<T, Columns...>::FindColumn(StringSegment key, size_t& col) const
    {
-      return Parse(s, var.*field_pointer);
+      const char* str = key.Data();
+      size_t length = key.Length();
+
+      uint8_t candidate = slots[GetSlot(str, length, seed)];
+      if ((candidate == kEmptySlot) || (lengths[candidate] != length)) return false;
+
+      for (size_t i = 0; i < length; i++)
+      {
+         if (ToLowerAscii(str[i]) != ToLowerAscii(names[candidate][i])) return false;
+      }
+
+      col = candidate;
+      return true;
    }
 
-   template<class T, class C>
-   void FieldAdapter<T, C>::ToString(const T& var, std::string& s /* out */) const
+   template<class T, class... Columns>
+   template<class F>
+   bool StaticSchema<T, Columns...>::VisitColumn(size_t col, F&& func) const
    {
-      Encode(var.*field_pointer, s);
+      return VisitColumn(col, func, std::index_sequence_for<Columns...>());
    }
 
-   template<class T, class C>
-   bool FieldAdapter<T, C>::EqualsDefaultValue(const T& var) const
+   // a chain of comparisons with the column numbers, which the compiler
+   // turns into a switch
+   template<class T, class... Columns>
+   template<class F, size_t... I>
+   bool StaticSchema<T, Columns...>::VisitColumn(size_t col, F&& func, std::index_sequence<I...>) const
    {
-      return (var.*field_pointer == defaultValue);
+      bool bResult = false;
+      (void) (((col == I) && ((bResult = func(std::get<I>(columns))), true)) || ...);
+      return bResult;
    }
 
-   template<class T, class C>
-   void FieldAdapter<T, C>::SetDefaultValue(T& var) const
+   template<class T, class... Columns>
+   template<class F>
+   void StaticSchema<T, Columns...>::ForEachColumn(F&& func) const
    {
-      var.*field_pointer = defaultValue;
+      std::apply([&func](const Columns&... column) { (func(column), ...); }, columns);
    }
 
-   AbstractLineParser::AbstractLineParser() : lineNumber(0), isOK (true)
+   template<class Derived, const auto& kSchema>
+   StaticAdapterBase<Derived, kSchema>::StaticAdapterBase()
    {
-      //empty
+      for (size_t col = 0; col < columnNames.size(); col++)
+      {
+         columnNames[col] = kSchema.GetColumnName(col);
+      }
    }
 
-   bool AbstractLineParser::IsOK() const
+   template<class Derived, const auto& kSchema>
+   typename StaticAdapterBase<Derived, kSchema>::DataType& StaticAdapterBase<Derived, kSchema>::Record(size_t row)
    {
-      return isOK;
+      return static_cast<Derived*>(this)->GetRecord(row);
    }
 
-   void AbstractLineParser::ClearErrors()
+   template<class Derived, const auto& kSchema>
+   const typename StaticAdapterBase<Derived, kSchema>::DataType& StaticAdapterBase<Derived, kSchema>::Record(size_t row) const
    {
-      isOK = true;
+      return static_cast<const Derived*>(this)->GetRecord(row);
    }
 
-   void AbstractLineParser::ParseFile(const char* filename, bool shouldExitOnError)
+   template<class Derived, const auto& kSchema>
+   void StaticAdapterBase<Derived, kSchema>::SetDefaultValues(size_t row)
    {
-      bExitOnError = shouldExitOnError;
-      ClearErrors();
+      DataType& theRecord = Record(row);
 
-      lineNumber = 0;
-      std::ifstream input;
-      input.open(filename);
+      kSchema.ForEachColumn([&theRecord](const auto& column)
+      {
+         theRecord.*column.field = column.GetDefaultValue();
+      });
+   }
 
-      CheckCondition(input.good(), "Cannot open input file.");
-      if (!IsOK()) return;
+   template<class Derived, const auto& kSchema>
+   const std::string& StaticAdapterBase<Derived, kSchema>::GetColumnName(size_t col) const
+   {
+      assert(col < ColumnCount());
+      return columnNames[col];
+   }
 
-      PreParse();
-      if (!IsOK()) return;
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::GetValue(size_t row, size_t col, std::string& value) const
+   {
+      const DataType& theRecord = Record(row);
 
-      while (!input.eof())
+      return kSchema.VisitColumn(col, [&](const auto& column)
       {
-         lineNumber++;
-         std::string str;
-         std::getline(input, str);
-         StringSegment ssegment(str);
+         Encode(theRecord.*column.field, value);
+         return true;
+      });
+   }
 
-         if (!ssegment.IsEmpty())
-         {
-            ParseLine(ssegment);
-            if (!IsOK()) return;
-         }
-      }
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::SetValue(size_t row, size_t col, StringSegment value)
+   {
+      DataType& theRecord = Record(row);
 
-      PostParse();
+      return kSchema.VisitColumn(col, [&](const auto& column)
+      {
+         return Parse(value, theRecord.*column.field);
+      });
    }
 
-   void AbstractLineParser::CheckCondition(bool bCondition, const char* error)
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::SetValue(size_t row, StringSegment key, StringSegment value)
    {
-      if (!bCondition)
-      {
-         isOK = false;
+      size_t col = 0;
+      return kSchema.FindColumn(key, col) && SetValue(row, col, value);
+   }
 
-         if (bExitOnError)
-         {
-            std::cout << std::endl << std::endl << "Error: " << error;
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::WriteValue(size_t row, size_t col, OutputBuffer& out) const
+   {
+      const DataType& theRecord = Record(row);
 
-            if (lineNumber != 0)
-            {
-               std::cout << std::endl
-                         << "Line number: " << lineNumber << "."
-                         << std::endl << std::endl;
-            }
-            else
-            {
-               std::cout << std::endl << std::endl;
-            }
+      return kSchema.VisitColumn(col, [&](const auto& column)
+      {
+         Encode(theRecord.*column.field, out);
+         return true;
+      });
+   }
 
-            exit(1);
-         }
-      }
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::GetColumnByName(StringSegment key, size_t& col) const
+   {
+      return kSchema.FindColumn(key, col);
    }
 
-   void StringToLowerCase(std::string& str)
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::EqualsDefaultValue(size_t row, size_t col) const
    {
-      std::transform(str.begin(), str.end(), str.begin(), tolower);
+      const DataType& theRecord = Record(row);
+
+      return kSchema.VisitColumn(col, [&](const auto& column)
+      {
+         return (theRecord.*column.field == column.GetDefaultValue());
+      });
    }
 
-   void StringToLowerCase(const std::string& inStr, std::string& outStr)
+   template<class Derived, const auto& kSchema>
+   size_t StaticAdapterBase<Derived, kSchema>::ColumnCount() const
    {
-      outStr.resize(inStr.size());
-      std::transform(inStr.begin(), inStr.end(), outStr.begin(), tolower);
+      return columnNames.size();
    }
 
-   bool ITable::GetValue(size_t row, StringSegment key, std::string& value) const
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out) const
    {
-      size_t col = 0;
-      bool bResult = GetColumnByName(key, col);
+      assert(firstRow + count <= this->RowCount());
 
-      if (bResult)
+      return kSchema.VisitColumn(col, [&](const auto& column)
       {
-         bResult = GetValue(row, col, value);
-      }
+         for (size_t row = firstRow; row < firstRow + count; row++)
+         {
+            EncodeBinary(Record(row).*column.field, out);
+         }
 
-      return bResult;
+         return true;
+      });
    }
 
-   bool ITable::SetValue(size_t row, StringSegment key, StringSegment value)
+   template<class Derived, const auto& kSchema>
+   bool StaticAdapterBase<Derived, kSchema>::ReadColumn(size_t col, size_t firstRow, size_t count, const char*& p, const char* end)
    {
-      size_t col = 0;
-      bool bResult = GetColumnByName(key, col);
+      assert(firstRow + count <= this->RowCount());
 
-      if (bResult)
+      return kSchema.VisitColumn(col, [&](const auto& column)
       {
-         bResult = SetValue(row, col, value);
-      }
+         for (size_t row = firstRow; row < firstRow + count; row++)
+         {
+            if (!DecodeBinary(p, end, Record(row).*column.field)) return false;
+         }
 
-      return bResult;
+         return true;
+      });
    }
 
-   template<class T>
-   bool AbstractTableAdapter<T>::AddNamedColumn(const char* name, std::shared_ptr<BaseFieldAdapter<T>> pField)
+   template<class Derived, const auto& kSchema>
+   const char* StaticAdapterBase<Derived, kSchema>::GetColumnType(size_t col) const
    {
-      std::string strFieldName(name);
-      StringToLowerCase(strFieldName);
+      const char* type = "";
 
-      auto it = name2id.find(strFieldName);
+      kSchema.VisitColumn(col, [&](const auto& column)
+      {
+         typedef typename std::decay_t<decltype(column)>::FieldType FieldType;
+         type = BinaryTypeName(static_cast<const FieldType*>(nullptr));
+         return true;
+      });
 
-      //return false if the column already exists
-      if (it != name2id.end()) return false;
+      return type;
+   }
 
-      ColumnSpec cs;
-      cs.name.assign(name);
-      cs.fieldAdapter = pField;
+   template<const auto& kSchema>
+   bool StaticTableAdapter<kSchema>::NewRow(size_t& row)
+   {
+      data.emplace_back();
+      row = data.size() - 1;
+      this->SetDefaultValues(row);
+      return true;
+   }
 
-      columnSpecs.push_back(cs);
+   template<const auto& kSchema>
+   bool StaticTableAdapter<kSchema>::IsFixedSize() const
+   {
+      return false;
+   }
 
-      StringToLowerCase(strFieldName);
-      name2id[strFieldName] = columnSpecs.size() - 1;
+   template<const auto& kSchema>
+   size_t StaticTableAdapter<kSchema>::RowCount() const
+   {
+      return data.size();
+   }
 
+   template<const auto& kSchema>
+   std::unique_ptr<ITable> StaticTableAdapter<kSchema>::CreateSlice() const
+   {
+      return std::make_unique<StaticTableSlice<kSchema>>();
+   }
+
+   template<const auto& kSchema>
+   void StaticTableAdapter<kSchema>::AppendSlice(ITable& slice)
+   {
+      std::vector<DataType>& rows = dynamic_cast<StaticTableSlice<kSchema>&>(slice).rows;
+
+      data.reserve(data.size() + rows.size());
+      std::move(rows.begin(), rows.end(), std::back_inserter(data));
+      rows.clear();
+   }
+
+   template<const auto& kSchema>
+   typename StaticTableAdapter<kSchema>::DataType& StaticTableAdapter<kSchema>::GetRecord(size_t i)
+   {
+      assert(i < data.size());
+      return data[i];
+   }
+
+   template<const auto& kSchema>
+   const typename StaticTableAdapter<kSchema>::DataType& StaticTableAdapter<kSchema>::GetRecord(size_t i) const
+   {
+      assert(i < data.size());
+      return data[i];
+   }
+
+   template<const auto& kSchema>
+   bool StaticRecordAdapter<kSchema>::NewRow(size_t& /* row */)
+   {
+      return false;
+   }
+
+   template<const auto& kSchema>
+   bool StaticRecordAdapter<kSchema>::IsFixedSize() const
+   {
       return true;
    }
 
-   template<class T>
-   const std::string& AbstractTableAdapter<T>::GetColumnName(size_t col) const
+   template<const auto& kSchema>
+   size_t StaticRecordAdapter<kSchema>::RowCount() const
    {
-      assert(col < ColumnCount());
-      return columnSpecs[col].name;
+      return 1;
    }
 
-   template<class T>
-   void AbstractTableAdapter<T>::SetDefaultValues(size_t row)
+   template<const auto& kSchema>
+   typename StaticRecordAdapter<kSchema>::DataType& StaticRecordAdapter<kSchema>::GetRecord(size_t i)
    {
-      assert(row < RowCount());
+      assert(i == 0);
+      return data;
+   }
 
-      T& theRecord = GetRecord(row);
+   template<const auto& kSchema>
+   const typename StaticRecordAdapter<kSchema>::DataType& StaticRecordAdapter<kSchema>::GetRecord(size_t i) const
+   {
+      assert(i == 0);
+      return data;
+   }
 
-      for (ColumnSpec& spec : columnSpecs)
+   template<class Adapter>
+   bool StreamingTable<Adapter>::NewRow(size_t& row)
+   {
+      EmitRow();
+      return Adapter::NewRow(row);
+   }
+
+   template<class Adapter>
+   void StreamingTable<Adapter>::FinishRows()
+   {
+      EmitRow();
+   }
+
+   template<class Adapter>
+   std::unique_ptr<ITable> StreamingTable<Adapter>::CreateSlice() const
+   {
+      return nullptr;
+   }
+
+   template<class Adapter>
+   bool StreamingTable<Adapter>::WriteColumn(size_t /* col */, size_t /* firstRow */, size_t /* count */, std::string& /* out */) const
+   {
+      return false;
+   }
+
+   template<class Adapter>
+   void StreamingTable<Adapter>::SetCallback(Callback newCallback)
+   {
+      callback = std::move(newCallback);
+   }
+
+   template<class Adapter>
+   size_t StreamingTable<Adapter>::StreamedRowCount() const
+   {
+      return nRows;
+   }
+
+   // clear() keeps the capacity, so rows is allocated once
+   template<class Adapter>
+   void StreamingTable<Adapter>::EmitRow()
+   {
+      if (!rows.empty())
       {
-         spec.fieldAdapter->SetDefaultValue(theRecord);
+         assert(callback);
+         callback(std::move(rows.back()));
+         rows.clear();
+         nRows++;
       }
    }
 
    template<class T>
-   bool AbstractTableAdapter<T>::GetValue(size_t row, size_t col, std::string& value) const
+   BoundedQueue<T>::BoundedQueue(size_t capacity) :
+      capacity(std::max<size_t>(capacity, 1)), bClosed(false)
    {
-      assert(col < ColumnCount());
-      assert(row < RowCount());
+      //empty
+   }
 
-      auto theField = columnSpecs[col].fieldAdapter;
-      const T& theRecord = GetRecord(row);
+   template<class T>
+   void BoundedQueue<T>::Push(T&& value)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      notFull.wait(lock, [this] { return (values.size() < capacity) || bClosed; });
 
-      theField->ToString(theRecord, value);
-      return true;
+      if (bClosed) return;
+
+      values.push_back(std::move(value));
+      lock.unlock();
+      notEmpty.notify_one();
    }
 
    template<class T>
-   bool AbstractTableAdapter<T>::SetValue(size_t row, size_t col, StringSegment value)
+   bool BoundedQueue<T>::Pop(T& value)
    {
-      assert(col < ColumnCount());
-      assert(row < RowCount());
+      std::unique_lock<std::mutex> lock(mutex);
+      notEmpty.wait(lock, [this] { return !values.empty() || bClosed; });
 
-      auto theField = columnSpecs[col].fieldAdapter;
-      T& theRecord = GetRecord(row);
+      if (values.empty()) return false;
 
-      bool bResult = theField->FromString(theRecord, value);
-      return bResult;
+      value = std::move(values.front());
+      values.pop_front();
+      lock.unlock();
+      notFull.notify_one();
+
+      return true;
    }
 
    template<class T>
-   bool AbstractTableAdapter<T>::EqualsDefaultValue (size_t row, size_t col) const
+   void BoundedQueue<T>::Close()
    {
-      assert(col < ColumnCount());
-      assert(row < RowCount());
-
-      auto theField = columnSpecs[col].fieldAdapter;
-      const T& theRecord = GetRecord(row);
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         bClosed = true;
+      }
 
-      return theField->EqualsDefaultValue (theRecord);
+      notFull.notify_all();
+      notEmpty.notify_all();
    }
 
    template<class T>
-   bool AbstractTableAdapter<T>::GetColumnByName(StringSegment key, size_t& col) const
+   void BoundedQueue<T>::Cancel()
    {
-      std::string strFieldName;
-      key.CopyTo(strFieldName);
-      StringToLowerCase(strFieldName);
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         bClosed = true;
+         values.clear();
+      }
 
-      auto it = name2id.find(strFieldName);
+      notFull.notify_all();
+      notEmpty.notify_all();
+   }
 
-      if (it == name2id.end()) return false; /* not found */
-      col = it->second;
+   // The columns of AddDefaultProblemSetColumns.
+   constexpr auto kProblemSetSchema = MakeSchema<ProblemSetHeader>(
+      MakeColumn<ProblemSetHeader>("problem_set_number", &ProblemSetHeader::id),
+      MakeColumn<ProblemSetHeader, std::string>("student_name", &ProblemSetHeader::student_name),
+      MakeColumn<ProblemSetHeader>("problems", &ProblemSetHeader::problem_count),
+      MakeColumn<ProblemSetHeader>("time", &ProblemSetHeader::time),
+      MakeColumn<ProblemSetHeader>("test_mistakes", &ProblemSetHeader::test_mistakes));
+   ///////////////////////////////////////////////////////////////////////////////
 
-      assert(col < columnSpecs.size());
+   StringSegment::StringSegment(const std::string& s) : str(s.data())
+   {
+      iBegin = 0;
+      iEnd = s.length();
+   }
 
-      return true;
+   StringSegment::StringSegment(const char* data, size_t length) : str(data)
+   {
+      iBegin = 0;
+      iEnd = length;
    }
 
-   template<class T>
-   size_t AbstractTableAdapter<T>::ColumnCount() const
+   void StringSegment::CopyTo(std::string& dest) const
    {
-      return columnSpecs.size();
+      dest.assign(str + iBegin, iEnd - iBegin);
    }
 
-   template<class T>
-   bool TableAdapter<T>::NewRow(size_t& row)
+   bool StringSegment::CopyTo(char* buffer, size_t buffer_size) const
    {
-      data.emplace_back();
-      row = data.size() - 1;
-      this->SetDefaultValues(row);
-      return true;
+      assert(iBegin <= iEnd);
+      assert(buffer_size > 0);
+
+      size_t count = std::min(iEnd - iBegin, buffer_size - 1);
+
+      for (size_t i = 0; i < count; ++i)
+      {
+         buffer[i] = str[iBegin + i];
+      }
+
+      buffer[count] = 0;
+
+      return (count == (iEnd - iBegin));
    }
 
-   template<class T>
-   size_t TableAdapter<T>::RowCount() const
+   size_t StringSegment::CountChars(char c) const
    {
-      return data.size();
+      return (std::count (str + iBegin, str + iEnd, c));
    }
 
-   template<class T>
-   bool TableAdapter<T>::IsFixedSize() const
+   const char* StringSegment::Data() const
    {
-      return false;
+      return str + iBegin;
+   }
+
+   bool StringSegment::IsEmpty() const
+   {
+      return (iBegin == iEnd);
+   }
+
+   size_t StringSegment::Length() const
+   {
+      assert(iBegin <= iEnd);
+      return (iEnd - iBegin);
+   }
+
+   char StringSegment::ReadLeft()
+   {
+      char result = 0;
+      if (iBegin < iEnd)
+      {
+         result = str[iBegin];
+         iBegin++;
+      }
+
+      return result;
+   }
+
+   char StringSegment::ReadRight()
+   {
+      if (iBegin < iEnd)
+      {
+         iEnd--;
+         return str[iEnd];
+      }
+
+      return 0;
+   }
+
+   char StringSegment::FirstChar() const
+   {
+      assert(iEnd > iBegin);
+      return str[iBegin];
+   }
+
+   char StringSegment::LastChar() const
+   {
+      assert(iEnd > iBegin);
+      return str[iEnd - 1];
+   }
+
+   void StringSegment::RemovePrefix(size_t count)
+   {
+      iBegin = std::min(iEnd, iBegin + count);
+   }
+
+   void StringSegment::RemoveSuffix(size_t count)
+   {
+      iEnd = std::max(iBegin + count, iEnd) - count;
+   }
+
+   void StringSegment::Trim()
+   {
+      TrimLeft();
+      TrimRight();
+   }
+
+   void StringSegment::TrimLeft()
+   {
+      while ((iBegin < iEnd) &&
+             (isspace(str[iBegin]) || (str[iBegin] == '\r')))
+      {
+         iBegin++;
+      }
+   }
+
+   void StringSegment::TrimRight()
+   {
+      while ((iBegin < iEnd) &&
+             (isspace(str[iEnd - 1]) || (str[iEnd - 1] == '\r')))
+      {
+         iEnd--;
+      }
+   }
+
+   bool StringSegment::Match(const char* pattern, bool bCaseSensitive /* = false */)
+   {
+      assert(iBegin <= iEnd);
+
+      size_t iStr = iBegin;
+      size_t iPattern = 0;
+
+      bool bMatch = true;
+      while ((pattern[iPattern] != 0) && (iStr < iEnd) && bMatch)
+      {
+         bool bEqualChars = (pattern[iPattern] == str[iStr]);
+
+         if (!bEqualChars)
+         {
+            if (!bCaseSensitive)
+            {
+               bEqualChars = (tolower(pattern[iPattern]) == tolower(str[iPattern]));
+            }
+            bMatch = bMatch && bEqualChars;
+         }
+
+         iStr++;
+         iPattern++;
+      }
+
+      bMatch = bMatch && (pattern[iPattern] == 0) && (iStr == iEnd);
+
+      return bMatch;
+   }
+
+   bool StringSegment::Match(StringSegment pattern, bool bCaseSensitive /* = false */)
+   {
+      size_t len = Length();
+      if (len != pattern.Length()) return false;
+
+      for (size_t i = 0; i < len; i++)
+      {
+         bool bEqualChars = (pattern[i] == str[i]);
+
+         if (!bEqualChars)
+         {
+            if (!bCaseSensitive)
+            {
+               bEqualChars = (tolower(pattern[i]) == tolower(str[i]));
+            }
+
+            if (!bEqualChars) return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool StringSegment::Split(char delimiter, StringSegment& prefix)
+   {
+      assert(this != &prefix);
+
+      if (!IsEmpty())
+      {
+         size_t i = iBegin;
+
+         while ((i < iEnd) && (str[i] != delimiter)) i++;
+
+         prefix.iBegin = iBegin;
+         prefix.iEnd = i;
+         iBegin = std::min(i + 1, iEnd);
+
+         return true;
+      }
+      else
+      {
+         prefix.iBegin = 0;
+         prefix.iEnd = 0;
+
+         return false;
+      }
+   }
+
+   char StringSegment::operator [](size_t index) const
+   {
+      assert(iBegin + index < iEnd);
+      return str[iBegin + index];
+   }
+
+   template<class T>
+   bool BaseFieldAdapter<T>::FromString(T& var, const std::string& str) const
+   {
+      StringSegment s(str);
+      return FromString(var, s);
+   }
+
+   template<class T, class C>
+   bool FieldAdapter<T, C>::FromString(T& var, StringSegment s) const
+   {
+      return Parse(s, var.*field_pointer);
+   }
+
+   template<class T, class C>
+   void FieldAdapter<T, C>::ToString(const T& var, std::string& s /* out */) const
+   {
+      Encode(var.*field_pointer, s);
+   }
+
+   template<class T>
+   void BaseFieldAdapter<T>::ToBuffer(const T& var, OutputBuffer& out) const
+   {
+      std::string value;
+      ToString(var, value);
+      out.Append(value);
+   }
+
+   template<class T, class C>
+   void FieldAdapter<T, C>::ToBuffer(const T& var, OutputBuffer& out) const
+   {
+      Encode(var.*field_pointer, out);
+   }
+
+   template<class T>
+   bool BaseFieldAdapter<T>::ToBinary(const T& /* var */, std::string& /* out */) const
+   {
+      return false;
+   }
+
+   template<class T>
+   bool BaseFieldAdapter<T>::FromBinary(T& /* var */, const char*& /* p */, const char* /* end */) const
+   {
+      return false;
+   }
+
+   template<class T>
+   const char* BaseFieldAdapter<T>::GetBinaryType() const
+   {
+      return "";
+   }
+
+   template<class T, class C>
+   bool FieldAdapter<T, C>::ToBinary(const T& var, std::string& out) const
+   {
+      EncodeBinary(var.*field_pointer, out);
+      return true;
+   }
+
+   template<class T, class C>
+   bool FieldAdapter<T, C>::FromBinary(T& var, const char*& p, const char* end) const
+   {
+      return DecodeBinary(p, end, var.*field_pointer);
+   }
+
+   template<class T, class C>
+   const char* FieldAdapter<T, C>::GetBinaryType() const
+   {
+      return BinaryTypeName(static_cast<const C*>(nullptr));
+   }
+
+   template<class T, class C>
+   bool FieldAdapter<T, C>::EqualsDefaultValue(const T& var) const
+   {
+      return (var.*field_pointer == defaultValue);
+   }
+
+   template<class T, class C>
+   void FieldAdapter<T, C>::SetDefaultValue(T& var) const
+   {
+      var.*field_pointer = defaultValue;
+   }
+
+   AbstractLineParser::AbstractLineParser() :
+      lineNumber(0), bExitOnError(false), isOK (true), error(nullptr)
+   {
+      //empty
+   }
+
+   bool AbstractLineParser::IsOK() const
+   {
+      return isOK;
+   }
+
+   void AbstractLineParser::ClearErrors()
+   {
+      isOK = true;
+      error = nullptr;
+   }
+
+   size_t AbstractLineParser::GetLineNumber() const
+   {
+      return lineNumber;
+   }
+
+   const char* AbstractLineParser::GetError() const
+   {
+      return error;
+   }
+
+   void AbstractLineParser::ParseText(const char* data, size_t size)
+   {
+      ParseLines(data, size);
+   }
+
+   void AbstractLineParser::ParseMappedFile(const char* /* filename */, const MappedFile& file, bool shouldExitOnError)
+   {
+      ParseBuffer(file.Data(), file.Size(), shouldExitOnError);
+   }
+
+   OutputBuffer::OutputBuffer(std::ostream& out, size_t capacity) :
+      out(out), capacity(std::max<size_t>(capacity, 64)), buffer(new char[this->capacity]), size(0)
+   {
+      //empty
+   }
+
+   OutputBuffer::~OutputBuffer()
+   {
+      Flush();
+   }
+
+   void OutputBuffer::Append(char c)
+   {
+      if (size == capacity) Flush();
+      buffer[size++] = c;
+   }
+
+   void OutputBuffer::Append(const char* str)
+   {
+      Append(str, std::strlen(str));
+   }
+
+   void OutputBuffer::Append(const char* str, size_t length)
+   {
+      if (length > capacity - size)
+      {
+         Flush();
+
+         // too long to buffer
+         if (length > capacity)
+         {
+            out.write(str, length);
+            return;
+         }
+      }
+
+      std::memcpy(buffer.get() + size, str, length);
+      size += length;
+   }
+
+   void OutputBuffer::Append(const std::string& str)
+   {
+      Append(str.data(), str.size());
+   }
+
+   void OutputBuffer::AppendInt(int value)
+   {
+      // an int has at most 11 characters
+      if (capacity - size < 11) Flush();
+
+      char* first = buffer.get() + size;
+      size += std::to_chars(first, buffer.get() + capacity, value).ptr - first;
+   }
+
+   void OutputBuffer::Flush()
+   {
+      if (size > 0)
+      {
+         out.write(buffer.get(), size);
+         size = 0;
+      }
+   }
+
+   MappedFile::MappedFile(const char* filename) : data(nullptr), size(0), mtime(0), isOpen(false)
+   {
+#if TEST_FRAMEWORK_HAS_MMAP
+      int fd = open(filename, O_RDONLY);
+      if (fd < 0) return;
+
+      struct stat st;
+      if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode))
+      {
+         size = static_cast<size_t>(st.st_size);
+#if defined(__APPLE__)
+         mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+         mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+
+         if (size == 0)
+         {
+            isOpen = true;
+         }
+         else
+         {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p != MAP_FAILED)
+            {
+               madvise(p, size, MADV_SEQUENTIAL);
+               data = static_cast<const char*>(p);
+               isOpen = true;
+            }
+         }
+      }
+
+      close(fd);
+#endif
+   }
+
+   MappedFile::~MappedFile()
+   {
+#if TEST_FRAMEWORK_HAS_MMAP
+      if (data != nullptr)
+      {
+         munmap(const_cast<char*>(data), size);
+      }
+#endif
+   }
+
+   bool MappedFile::IsOpen() const
+   {
+      return isOpen;
+   }
+
+   const char* MappedFile::Data() const
+   {
+      return data;
+   }
+
+   size_t MappedFile::Size() const
+   {
+      return size;
+   }
+
+   int64_t MappedFile::ModificationTime() const
+   {
+      return mtime;
+   }
+
+   void AbstractLineParser::ParseBuffer(const char* data, size_t size, bool shouldExitOnError)
+   {
+      bExitOnError = shouldExitOnError;
+      ClearErrors();
+      lineNumber = 0;
+
+      PreParse();
+      if (!IsOK()) return;
+
+      ParseText(data, size);
+      if (!IsOK()) return;
+
+      PostParse();
+   }
+
+   // Splits the buffer into lines without copying them.
+   void AbstractLineParser::ParseLines(const char* data, size_t size)
+   {
+      const char* end = data + size;
+
+      for (const char* p = data; p < end; )
+      {
+         lineNumber++;
+
+         const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+         if (eol == nullptr) eol = end;
+
+         StringSegment ssegment(p, eol - p);
+
+         if (!ssegment.IsEmpty())
+         {
+            ParseLine(ssegment);
+            if (!IsOK()) return;
+         }
+
+         p = eol + 1;
+      }
+   }
+
+   void AbstractLineParser::ParseFile(const char* filename, bool shouldExitOnError)
+   {
+      Trace::Span span("ParseFile", "framework");
+
+      // Map the file if possible: then lines are parsed in place,
+      // without reading them into strings.
+      MappedFile file(filename);
+
+      if (file.IsOpen())
+      {
+         ParseMappedFile(filename, file, shouldExitOnError);
+         return;
+      }
+
+      bExitOnError = shouldExitOnError;
+      ClearErrors();
+
+      lineNumber = 0;
+      std::ifstream input;
+      input.open(filename);
+
+      CheckCondition(input.good(), "Cannot open input file.");
+      if (!IsOK()) return;
+
+      PreParse();
+      if (!IsOK()) return;
+
+      while (!input.eof())
+      {
+         lineNumber++;
+         std::string str;
+         std::getline(input, str);
+         StringSegment ssegment(str);
+
+         if (!ssegment.IsEmpty())
+         {
+            ParseLine(ssegment);
+            if (!IsOK()) return;
+         }
+      }
+
+      PostParse();
+   }
+
+   void AbstractLineParser::ExitOnError()
+   {
+      if (!isOK)
+      {
+         bExitOnError = true;
+         CheckCondition(false, error);
+      }
+   }
+
+   void AbstractLineParser::ReportError(size_t line, const char* error)
+   {
+      lineNumber = line;
+      CheckCondition(false, error);
+   }
+
+   void AbstractLineParser::CheckCondition(bool bCondition, const char* error)
+   {
+      if (!bCondition)
+      {
+         isOK = false;
+         this->error = error;
+
+         if (bExitOnError)
+         {
+            std::cout << std::endl << std::endl << "Error: " << error;
+
+            if (lineNumber != 0)
+            {
+               std::cout << std::endl
+                         << "Line number: " << lineNumber << "."
+                         << std::endl << std::endl;
+            }
+            else
+            {
+               std::cout << std::endl << std::endl;
+            }
+
+            exit(1);
+         }
+      }
+   }
+
+   void StringToLowerCase(std::string& str)
+   {
+      std::transform(str.begin(), str.end(), str.begin(), tolower);
+   }
+
+   void StringToLowerCase(const std::string& inStr, std::string& outStr)
+   {
+      outStr.resize(inStr.size());
+      std::transform(inStr.begin(), inStr.end(), outStr.begin(), tolower);
+   }
+
+   bool ITable::GetValue(size_t row, StringSegment key, std::string& value) const
+   {
+      size_t col = 0;
+      bool bResult = GetColumnByName(key, col);
+
+      if (bResult)
+      {
+         bResult = GetValue(row, col, value);
+      }
+
+      return bResult;
+   }
+
+   bool ITable::WriteValue(size_t row, size_t col, OutputBuffer& out) const
+   {
+      std::string value;
+      bool bResult = GetValue(row, col, value);
+
+      if (bResult)
+      {
+         out.Append(value);
+      }
+
+      return bResult;
+   }
+
+   std::unique_ptr<ITable> ITable::CreateSlice() const
+   {
+      return nullptr;
+   }
+
+   void ITable::AppendSlice(ITable& /* slice */)
+   {
+      assert(false);
+   }
+
+   bool ITable::WriteColumn(size_t /* col */, size_t /* firstRow */, size_t /* count */, std::string& /* out */) const
+   {
+      return false;
+   }
+
+   bool ITable::ReadColumn(size_t /* col */, size_t /* firstRow */, size_t /* count */, const char*& /* p */, const char* /* end */)
+   {
+      return false;
+   }
+
+   const char* ITable::GetColumnType(size_t /* col */) const
+   {
+      return "";
+   }
+
+   void ITable::FinishRows()
+   {
+      //empty
+   }
+
+   bool ITable::SetValue(size_t row, StringSegment key, StringSegment value)
+   {
+      size_t col = 0;
+      bool bResult = GetColumnByName(key, col);
+
+      if (bResult)
+      {
+         bResult = SetValue(row, col, value);
+      }
+
+      return bResult;
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::AddNamedColumn(const char* name, std::shared_ptr<BaseFieldAdapter<T>> pField)
+   {
+      std::string strFieldName(name);
+      StringToLowerCase(strFieldName);
+
+      auto it = name2id.find(strFieldName);
+
+      //return false if the column already exists
+      if (it != name2id.end()) return false;
+
+      ColumnSpec cs;
+      cs.name.assign(name);
+      cs.fieldAdapter = pField;
+
+      columnSpecs.push_back(cs);
+
+      StringToLowerCase(strFieldName);
+      name2id[strFieldName] = columnSpecs.size() - 1;
+
+      return true;
+   }
+
+   template<class T>
+   const std::string& AbstractTableAdapter<T>::GetColumnName(size_t col) const
+   {
+      assert(col < ColumnCount());
+      return columnSpecs[col].name;
+   }
+
+   template<class T>
+   void AbstractTableAdapter<T>::SetDefaultValues(size_t row)
+   {
+      assert(row < RowCount());
+
+      T& theRecord = GetRecord(row);
+
+      for (ColumnSpec& spec : columnSpecs)
+      {
+         spec.fieldAdapter->SetDefaultValue(theRecord);
+      }
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::GetValue(size_t row, size_t col, std::string& value) const
+   {
+      assert(col < ColumnCount());
+      assert(row < RowCount());
+
+      auto theField = columnSpecs[col].fieldAdapter;
+      const T& theRecord = GetRecord(row);
+
+      theField->ToString(theRecord, value);
+      return true;
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::SetValue(size_t row, size_t col, StringSegment value)
+   {
+      assert(col < ColumnCount());
+      assert(row < RowCount());
+
+      // a reference: copying the shared pointer would make parsing
+      // threads contend for its reference count
+      const auto& theField = columnSpecs[col].fieldAdapter;
+      T& theRecord = GetRecord(row);
+
+      bool bResult = theField->FromString(theRecord, value);
+      return bResult;
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::WriteValue(size_t row, size_t col, OutputBuffer& out) const
+   {
+      assert(col < ColumnCount());
+      assert(row < RowCount());
+
+      columnSpecs[col].fieldAdapter->ToBuffer(GetRecord(row), out);
+      return true;
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::EqualsDefaultValue (size_t row, size_t col) const
+   {
+      assert(col < ColumnCount());
+      assert(row < RowCount());
+
+      auto theField = columnSpecs[col].fieldAdapter;
+      const T& theRecord = GetRecord(row);
+
+      return theField->EqualsDefaultValue (theRecord);
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::GetColumnByName(StringSegment key, size_t& col) const
+   {
+      // lowercase short keys on the stack to avoid an allocation per cell
+      char buffer[64];
+      std::string strFieldName;
+      std::string_view fieldName;
+
+      if (key.Length() < sizeof(buffer))
+      {
+         for (size_t i = 0; i < key.Length(); i++) buffer[i] = tolower(key[i]);
+         fieldName = std::string_view(buffer, key.Length());
+      }
+      else
+      {
+         key.CopyTo(strFieldName);
+         StringToLowerCase(strFieldName);
+         fieldName = strFieldName;
+      }
+
+      auto it = name2id.find(fieldName);
+
+      if (it == name2id.end()) return false; /* not found */
+      col = it->second;
+
+      assert(col < columnSpecs.size());
+
+      return true;
+   }
+
+   template<class T>
+   size_t AbstractTableAdapter<T>::ColumnCount() const
+   {
+      return columnSpecs.size();
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::WriteColumn(size_t col, size_t firstRow, size_t count, std::string& out) const
+   {
+      assert(col < ColumnCount());
+      assert(firstRow + count <= RowCount());
+
+      const auto& theField = columnSpecs[col].fieldAdapter;
+
+      for (size_t row = firstRow; row < firstRow + count; row++)
+      {
+         if (!theField->ToBinary(GetRecord(row), out)) return false;
+      }
+
+      return true;
+   }
+
+   template<class T>
+   bool AbstractTableAdapter<T>::ReadColumn(size_t col, size_t firstRow, size_t count, const char*& p, const char* end)
+   {
+      assert(col < ColumnCount());
+      assert(firstRow + count <= RowCount());
+
+      const auto& theField = columnSpecs[col].fieldAdapter;
+
+      for (size_t row = firstRow; row < firstRow + count; row++)
+      {
+         if (!theField->FromBinary(GetRecord(row), p, end)) return false;
+      }
+
+      return true;
+   }
+
+   template<class T>
+   const char* AbstractTableAdapter<T>::GetColumnType(size_t col) const
+   {
+      assert(col < ColumnCount());
+
+      return columnSpecs[col].fieldAdapter->GetBinaryType();
+   }
+
+   template<class T>
+   bool TableAdapter<T>::NewRow(size_t& row)
+   {
+      data.emplace_back();
+      row = data.size() - 1;
+      this->SetDefaultValues(row);
+      return true;
+   }
+
+   template<class T>
+   size_t TableAdapter<T>::RowCount() const
+   {
+      return data.size();
+   }
+
+   template<class T>
+   bool TableAdapter<T>::IsFixedSize() const
+   {
+      return false;
+   }
+
+   template<class T>
+   std::unique_ptr<ITable> TableAdapter<T>::CreateSlice() const
+   {
+      return std::make_unique<TableSlice<T>>(*this);
+   }
+
+   template<class T>
+   void TableAdapter<T>::AppendSlice(ITable& slice)
+   {
+      std::vector<T>& rows = dynamic_cast<TableSlice<T>&>(slice).rows;
+
+      data.reserve(data.size() + rows.size());
+      std::move(rows.begin(), rows.end(), std::back_inserter(data));
+      rows.clear();
+   }
+
+   template<class T>
+   T& TableAdapter<T>::GetRecord(size_t i)
+   {
+      assert(i < data.size());
+      return data[i];
+   }
+
+   template<class T>
+   const T& TableAdapter<T>::GetRecord(size_t i) const
+   {
+      assert(i < data.size());
+      return data[i];
+   }
+
+   template<class T>
+   bool RecordAdapter<T>::NewRow(size_t& row)
+   {
+      return false;
+   }
+
+   template<class T>
+   bool RecordAdapter<T>::IsFixedSize() const
+   {
+      return true;
+   }
+
+   template<class T>
+   size_t RecordAdapter<T>::RowCount() const
+   {
+      return 1;
+   }
+
+   template<class T>
+   T& RecordAdapter<T>::GetRecord(size_t i)
+   {
+      assert(i == 0);
+      return data;
+   }
+
+   template<class T>
+   const T& RecordAdapter<T>::GetRecord(size_t i) const
+   {
+      assert(i == 0);
+      return data;
+   }
+
+   BasicYamlParser::BasicYamlParser(ITable* pHeader, ITable* pTable) :
+                           AbstractLineParser(), pHeader(pHeader), pTable(pTable), isHeaderSection(true),
+                           nThreads(0), bCacheEnabled(true)
+   {
+      assert(pHeader != nullptr);
+      assert(pHeader->RowCount() > 0);
+      assert(pTable != nullptr);
+      assert(!pTable->IsFixedSize());
+   }
+
+   void BasicYamlParser::SetHeaderAdapter(ITable* newAdapter)
+   {
+      assert(newAdapter != nullptr);
+      assert(newAdapter->RowCount() > 0);
+      pHeader = newAdapter;
+   }
+
+   void BasicYamlParser::SetTableAdapter(ITable* newAdapter)
+   {
+      assert(newAdapter != nullptr);
+      assert(!newAdapter->IsFixedSize());
+      pTable = newAdapter;
+   }
+
+   void BasicYamlParser::SetThreadCount(size_t count)
+   {
+      nThreads = count;
+   }
+
+   void BasicYamlParser::SetCacheEnabled(bool bEnabled)
+   {
+      bCacheEnabled = bEnabled;
+   }
+
+   void BasicYamlParser::PreParse()
+   {
+      isHeaderSection = true;
+   }
+
+   void BasicYamlParser::PostParse()
+   {
+      if (pTable != nullptr)
+      {
+         pTable->FinishRows();
+      }
+   }
+
+   // The start of the first line at or after **p** that starts a record,
+   // i.e., whose first non-space character is '-'; **p** must be the
+   // start of a line.
+   const char* FindRecord(const char* p, const char* end)
+   {
+      while (p < end)
+      {
+         const char* q = p;
+         while ((q < end) && (*q != '\n') && isspace(*q)) q++;
+
+         if ((q < end) && (*q == '-')) return p;
+
+         const char* eol = static_cast<const char*>(std::memchr(q, '\n', end - q));
+         p = (eol == nullptr) ? end : eol + 1;
+      }
+
+      return end;
+   }
+
+   // Parses the header serially and splits the records between threads
+   // at record boundaries. Every thread parses its chunk into a slice of
+   // the table, and the slices are appended in order, so the table and
+   // the first error reported are the same as with serial parsing.
+   void BasicYamlParser::ParseText(const char* data, size_t size)
+   {
+      const char* end = data + size;
+      const char* records = FindRecord(data, end);
+
+      ParseLines(data, records - data);
+      if (!IsOK()) return;
+
+      size_t threadCount = (nThreads != 0) ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+      size_t chunkCount = std::min(threadCount, static_cast<size_t>(end - records) / kMinChunkSize);
+
+      std::vector<std::unique_ptr<ITable>> slices;
+      for (size_t k = 0; (k < chunkCount) && !isHeaderSection; k++)
+      {
+         std::unique_ptr<ITable> slice = pTable->CreateSlice();
+         if (!slice) break;
+         slices.push_back(std::move(slice));
+      }
+
+      // records in the header section are errors; leave them to ParseLines
+      if ((chunkCount < 2) || (slices.size() < chunkCount))
+      {
+         ParseLines(records, end - records);
+         return;
+      }
+
+      std::vector<const char*> bounds(chunkCount + 1, end);
+      bounds[0] = records;
+
+      for (size_t k = 1; k < chunkCount; k++)
+      {
+         const char* p = records + (end - records) * k / chunkCount;
+         const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+         p = (eol == nullptr) ? end : eol + 1;
+
+         bounds[k] = FindRecord(std::max(p, bounds[k - 1]), end);
+      }
+
+      std::vector<BasicYamlParser> workers(chunkCount);
+      for (size_t k = 0; k < chunkCount; k++)
+      {
+         workers[k].pTable = slices[k].get();
+         workers[k].isHeaderSection = false;
+      }
+
+      auto parseChunk = [&](size_t k)
+      {
+         Profiler::RegisterThread();
+         Trace::Span span("ParseChunk", "framework");
+         workers[k].ParseLines(bounds[k], bounds[k + 1] - bounds[k]);
+      };
+
+      std::vector<std::thread> threads;
+      for (size_t k = 1; k < chunkCount; k++) threads.emplace_back(parseChunk, k);
+      parseChunk(0);
+      for (std::thread& t : threads) t.join();
+
+      for (size_t k = 0; k < chunkCount; k++)
+      {
+         pTable->AppendSlice(*slices[k]);
+
+         if (!workers[k].IsOK())
+         {
+            size_t line = GetLineNumber() + std::count(records, bounds[k], '\n') + workers[k].GetLineNumber();
+            ReportError(line, workers[k].GetError());
+            return;
+         }
+      }
+   }
+
+   void BasicYamlParser::ParseLine(StringSegment s)
+   {
+      assert(pTable != nullptr);
+
+      s.Trim();
+      if (s.IsEmpty()) return;
+
+      char firstChar = s.FirstChar();
+
+      if (firstChar == '#')
+      {
+         //comments
+         return;
+      }
+      else if (s.Match("data:"))
+      {
+         //start data section
+         isHeaderSection = false;
+         return;
+      }
+      else if (firstChar == '-')
+      {
+         CheckCondition(!isHeaderSection, "Invalid entry in the header section.");
+
+         size_t row;
+         pTable->NewRow(row);
+         s.RemovePrefix(1);
+
+         s.Trim();
+         if (s.IsEmpty()) return;
+      }
+
+      StringSegment prefix(s);
+      s.Split(':', prefix);
+      s.Trim();
+      prefix.Trim();
+
+      CheckCondition(!s.IsEmpty() && !prefix.IsEmpty(), "Key or value is empty.");
+      if (!IsOK()) return;
+
+      if (isHeaderSection)
+      {
+         CheckCondition(pHeader != nullptr, "Unexpected header.");
+         if (!IsOK()) return;
+
+         bool bResult = pHeader->SetValue(0, prefix, s);
+
+         CheckCondition(bResult, "Cannot parse a line.");
+         if (!IsOK()) return;
+      }
+      else
+      {
+         size_t tableSize = pTable->RowCount();
+         bool bResult = pTable->SetValue(tableSize - 1, prefix, s);
+
+         CheckCondition(bResult, "Cannot parse a line.");
+         if (!IsOK()) return;
+      }
+   }
+
+   // A fast non-cryptographic hash, to detect changed and corrupt files.
+   uint64_t HashBytes(const char* data, size_t size)
+   {
+      constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+
+      // four independent lanes keep the multiplier busy
+      uint64_t lanes[4] = {size, ~size, kMultiplier, ~kMultiplier};
+      size_t i = 0;
+
+      for (; i + 32 <= size; i += 32)
+      {
+         for (size_t k = 0; k < 4; k++)
+         {
+            uint64_t word;
+            std::memcpy(&word, data + i + 8 * k, sizeof(word));
+            lanes[k] = (lanes[k] ^ word) * kMultiplier;
+            lanes[k] ^= lanes[k] >> 29;
+         }
+      }
+
+      for (size_t k = 0; i < size; i += 8, k++)
+      {
+         uint64_t word = 0;
+         std::memcpy(&word, data + i, std::min<size_t>(8, size - i));
+         lanes[k] = (lanes[k] ^ word) * kMultiplier;
+         lanes[k] ^= lanes[k] >> 29;
+      }
+
+      uint64_t hash = 0;
+      for (uint64_t lane : lanes)
+      {
+         hash = (hash ^ lane) * kMultiplier;
+         hash ^= hash >> 32;
+      }
+
+      return hash;
+   }
+
+   // The layout of a parse cache file: this header, then the payload:
+   //   the header table: column count, (name, value as text) pairs;
+   //   the table: column count, row count, (name, type, size, column)
+   //   tuples, the type as GetColumnType names it.
+   // The header values are parsed again from text, so their types are
+   // not stored.
+   // A cache is used only if the version, the byte order, the payload
+   // hash and the size, time and hash of the input file all match.
+   struct ParseCacheHeader
+   {
+      static constexpr uint32_t kFormatVersion = 2;
+      static constexpr uint32_t kByteOrderMark = 0x01020304;
+
+      char magic[8];
+      uint32_t frameworkVersion;
+      uint32_t formatVersion;
+      uint32_t byteOrderMark;
+      uint32_t reserved;
+      uint64_t inputSize;
+      int64_t inputTime;
+      uint64_t inputHash;
+      uint64_t payloadSize;
+      uint64_t payloadHash;
+   };
+
+   const char kParseCacheMagic[8] = {'T', 'F', 'C', 'A', 'C', 'H', 'E', 0};
+
+   void BasicYamlParser::ParseMappedFile(const char* filename, const MappedFile& file, bool shouldExitOnError)
+   {
+      std::string cacheFilename = std::string(filename) + ".cache";
+
+      if (bCacheEnabled && (pHeader != nullptr) && ReadCache(cacheFilename, file))
+      {
+         ClearErrors();
+         return;
+      }
+
+      size_t firstRow = pTable->RowCount();
+      ParseBuffer(file.Data(), file.Size(), shouldExitOnError);
+
+      if (bCacheEnabled && (pHeader != nullptr) && IsOK())
+      {
+         WriteCache(cacheFilename, file, firstRow);
+      }
+   }
+
+   // Reads the whole cache into a slice of the table first, so that a
+   // stale or corrupt cache leaves the table unchanged.
+   bool BasicYamlParser::ReadCache(const std::string& cacheFilename, const MappedFile& file)
+   {
+      MappedFile cache(cacheFilename.c_str());
+      if (!cache.IsOpen() || (cache.Size() < sizeof(ParseCacheHeader))) return false;
+
+      ParseCacheHeader header;
+      std::memcpy(&header, cache.Data(), sizeof(header));
+
+      const char* p = cache.Data() + sizeof(header);
+      const char* end = cache.Data() + cache.Size();
+
+      if ((std::memcmp(header.magic, kParseCacheMagic, sizeof(header.magic)) != 0) ||
+          (header.frameworkVersion != GetTestFrameworkVersion()) ||
+          (header.formatVersion != ParseCacheHeader::kFormatVersion) ||
+          (header.byteOrderMark != ParseCacheHeader::kByteOrderMark) ||
+          (header.inputSize != file.Size()) ||
+          (header.inputTime != file.ModificationTime()) ||
+          (header.payloadSize != static_cast<uint64_t>(end - p)) ||
+          (header.payloadHash != HashBytes(p, end - p)) ||
+          (header.inputHash != HashBytes(file.Data(), file.Size())))
+      {
+         return false;
+      }
+
+      // the header table
+      uint64_t nHeaderCols = 0;
+      if (!DecodeBinary(p, end, nHeaderCols) || (nHeaderCols != pHeader->ColumnCount())) return false;
+
+      std::vector<std::string> headerValues(nHeaderCols);
+      for (size_t col = 0; col < nHeaderCols; col++)
+      {
+         std::string name;
+         if (!DecodeBinary(p, end, name) || (name != pHeader->GetColumnName(col))) return false;
+         if (!DecodeBinary(p, end, headerValues[col])) return false;
+      }
+
+      // the table
+      std::unique_ptr<ITable> slice = pTable->CreateSlice();
+      if (!slice) return false;
+
+      uint64_t nCols = 0;
+      uint64_t nRows = 0;
+      if (!DecodeBinary(p, end, nCols) || (nCols != slice->ColumnCount())) return false;
+      if (!DecodeBinary(p, end, nRows)) return false;
+
+      for (size_t i = 0; i < nRows; i++)
+      {
+         size_t row;
+         slice->NewRow(row);
+      }
+
+      for (size_t col = 0; col < nCols; col++)
+      {
+         std::string name;
+         std::string type;
+         uint64_t size = 0;
+         if (!DecodeBinary(p, end, name) || (name != slice->GetColumnName(col))) return false;
+         if (!DecodeBinary(p, end, type) || (type != slice->GetColumnType(col))) return false;
+         if (!DecodeBinary(p, end, size) || (size > static_cast<uint64_t>(end - p))) return false;
+
+         const char* columnEnd = p + size;
+         if (!slice->ReadColumn(col, 0, nRows, p, columnEnd) || (p != columnEnd)) return false;
+      }
+
+      if (p != end) return false;
+
+      for (size_t col = 0; col < nHeaderCols; col++)
+      {
+         if (!pHeader->SetValue(0, col, StringSegment(headerValues[col]))) return false;
+      }
+
+      pTable->AppendSlice(*slice);
+      return true;
+   }
+
+   // Writes the cache to a temporary file and renames it, so that
+   // a cache is either complete or absent. The name of the temporary
+   // file is unique to the process and the call, so that programs
+   // parsing the same file do not write into each other's files.
+   // Errors are ignored.
+   void BasicYamlParser::WriteCache(const std::string& cacheFilename, const MappedFile& file, size_t firstRow)
+   {
+      std::string payload;
+
+      EncodeBinary(static_cast<uint64_t>(pHeader->ColumnCount()), payload);
+      for (size_t col = 0; col < pHeader->ColumnCount(); col++)
+      {
+         std::string value;
+         pHeader->GetValue(0, col, value);
+         EncodeBinary(pHeader->GetColumnName(col), payload);
+         EncodeBinary(value, payload);
+      }
+
+      size_t nRows = pTable->RowCount() - firstRow;
+      EncodeBinary(static_cast<uint64_t>(pTable->ColumnCount()), payload);
+      EncodeBinary(static_cast<uint64_t>(nRows), payload);
+
+      for (size_t col = 0; col < pTable->ColumnCount(); col++)
+      {
+         std::string column;
+         if (!pTable->WriteColumn(col, firstRow, nRows, column)) return;
+
+         EncodeBinary(pTable->GetColumnName(col), payload);
+         EncodeBinary(std::string(pTable->GetColumnType(col)), payload);
+         EncodeBinary(static_cast<uint64_t>(column.size()), payload);
+         payload.append(column);
+      }
+
+      ParseCacheHeader header = {};
+      std::memcpy(header.magic, kParseCacheMagic, sizeof(header.magic));
+      header.frameworkVersion = GetTestFrameworkVersion();
+      header.formatVersion = ParseCacheHeader::kFormatVersion;
+      header.byteOrderMark = ParseCacheHeader::kByteOrderMark;
+      header.inputSize = file.Size();
+      header.inputTime = file.ModificationTime();
+      header.inputHash = HashBytes(file.Data(), file.Size());
+      header.payloadSize = payload.size();
+      header.payloadHash = HashBytes(payload.data(), payload.size());
+
+      static std::atomic<unsigned> nWrites{0};
+
+      std::string tempFilename = cacheFilename + ".";
+#if TEST_FRAMEWORK_HAS_MMAP
+      tempFilename += std::to_string(getpid()) + ".";
+#endif
+      tempFilename += std::to_string(nWrites.fetch_add(1)) + ".tmp";
+
+      std::ofstream out(tempFilename, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(payload.data(), payload.size());
+      out.close();
+
+      if (!out.good() || (std::rename(tempFilename.c_str(), cacheFilename.c_str()) != 0))
+      {
+         std::remove(tempFilename.c_str());
+      }
+   }
+
+   void WriteRecordToBuffer(OutputBuffer& out, ITable* table,
+                            size_t row, bool bWriteDefaultValues,
+                            bool bIndent)
+   {
+      if (bIndent) out.Append('\n');
+
+      size_t nCols = table->ColumnCount();
+      for (size_t j = 0; j < nCols; j++)
+      {
+         if (bIndent && (j == 0))
+         {
+            out.Append(" - ");
+         }
+
+         if (bWriteDefaultValues || !table->EqualsDefaultValue(row, j))
+         {
+            if (bIndent && (j != 0))
+            {
+               out.Append("   ");
+            }
+
+            out.Append(table->GetColumnName(j));
+            out.Append(": ");
+            table->WriteValue(row, j, out);
+            out.Append('\n');
+         }
+      }
+   }
+
+   void WriteTableToBuffer(OutputBuffer& out, ITable* table, ITable* header /* can be nullptr */,
+                           bool bWriteDefaultValues)
+   {
+      assert(table != nullptr);
+
+      size_t nRows = table->RowCount();
+
+      if (header != nullptr)
+      {
+         WriteRecordToBuffer(out, header, 0, bWriteDefaultValues, false);
+      }
+
+      out.Append("\ndata:\n");
+      for (size_t i = 0; i < nRows; i++)
+      {
+         WriteRecordToBuffer(out, table, i, bWriteDefaultValues, true);
+      }
+   }
+
+   // The stream versions write through an OutputBuffer; the stream is
+   // not flushed after every line.
+   void WriteRecordToStream(std::ostream& out, ITable* table,
+                            size_t row, bool bWriteDefaultValues,
+                            bool bIndent)
+   {
+      OutputBuffer buffer(out, OutputBuffer::kRecordCapacity);
+      WriteRecordToBuffer(buffer, table, row, bWriteDefaultValues, bIndent);
+   }
+
+   void WriteTableToStream(std::ostream& out, ITable* table, ITable* header /* can be nullptr */,
+                           bool bWriteDefaultValues)
+   {
+      OutputBuffer buffer(out);
+      WriteTableToBuffer(buffer, table, header, bWriteDefaultValues);
+   }
+
+   void WriteTableToFile(const char* filename, ITable* header, ITable* table,
+                         bool bWriteDefaultValues, const char* comments)
+   {
+      std::ofstream out;
+      out.open(filename);
+      ExitIfConditionFails(out.good(), "Cannot open output file!");
+
+      OutputBuffer buffer(out);
+
+      if (comments != nullptr)
+      {
+         buffer.Append(comments);
+      }
+
+      WriteTableToBuffer(buffer, table, header, bWriteDefaultValues);
+      buffer.Flush();
+
+      out.close();
+      ExitIfConditionFails(out.good(), "Cannot write output file!");
+   }
+
+   template<class T>
+   void PreprocessProblemSet(int problem_set_id, std::vector<T>& problems, ProblemSetHeader& header)
+   {
+      ExitIfConditionFails(header.id == problem_set_id, "Wrong problem set. Check problem set number.");
+      ExitIfConditionFails(header.problem_count == (int) problems.size(), "Input file is corrupted.");      
+
+      for (int i = 0; i < header.problem_count; i++)
+      {
+         ExitIfConditionFails(problems[i].id == (i + 1), "Input file is corrupted.");
+      }
+
+      header.tStart = std::chrono::high_resolution_clock::now();
+   }
+
+   template<class T>
+   void ProcessResults(std::vector<T>& problems, ProblemSetHeader& header)
+   {
+      Trace::Span span("ProcessResults", "framework");
+
+      std::chrono::high_resolution_clock::time_point tNow = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(tNow - header.tStart);
+      header.time = static_cast<int>(std::round(1000 * time_span.count()));
+
+      int nMistakes = 0;
+
+      for (int i = 0; i < header.problem_count; i++)
+      {
+         T& theProblem = problems[i];
+
+         if ((theProblem.student_answer != theProblem.correct_answer))
+         {
+            nMistakes++;
+            std::cout << std::endl;
+            std::cout << "Mistake in problem #" << (i + 1) << "." << std::endl;
+            std::cout << "Correct answer: " << theProblem.correct_answer << "." << std::endl;
+            std::cout << "Your answer: " << theProblem.student_answer << "." << std::endl;
+            std::cout << "=========================";
+         }
+      }
+
+      header.test_mistakes = nMistakes;
+
+      if (nMistakes > 0)
+      {
+         std::cout << std::endl << "Your algorithm made " << nMistakes << " mistake(s)." << std::endl;
+      }
+      else
+      {
+         std::cout << "Your algorithm solved all test problems correctly. Congratulations!" << std::endl;
+      }
    }
 
-   template<class T>
-   T& TableAdapter<T>::GetRecord(size_t i)
+   LatencyHistogram::LatencyHistogram() :
+      counts((64 - kSubBucketBits + 1) * kSubBuckets, 0)
    {
-      assert(i < data.size());
-      return data[i];
+      Clear();
    }
 
-   template<class T>
-   const T& TableAdapter<T>::GetRecord(size_t i) const
+   size_t LatencyHistogram::BucketIndex(uint64_t ns)
    {
-      assert(i < data.size());
-      return data[i];
+      if (ns < kSubBuckets) return static_cast<size_t>(ns);
+
+      int exponent = 63 - __builtin_clzll(ns);
+      int shift = exponent - kSubBucketBits;
+      return static_cast<size_t>((shift + 1) * kSubBuckets + ((ns >> shift) - kSubBuckets));
    }
 
-   template<class T>
-   bool RecordAdapter<T>::NewRow(size_t& row)
+   uint64_t LatencyHistogram::BucketUpperBound(size_t index)
    {
-      return false;
+      if (index < kSubBuckets) return index;
+
+      int shift = static_cast<int>(index / kSubBuckets) - 1;
+      uint64_t lower = (kSubBuckets + index % kSubBuckets) << shift;
+      return lower + ((uint64_t(1) << shift) - 1);
    }
 
-   template<class T>
-   bool RecordAdapter<T>::IsFixedSize() const
+   void LatencyHistogram::Add(uint64_t ns)
    {
-      return true;
+      counts[BucketIndex(ns)]++;
+      count++;
+      minValue = std::min(minValue, ns);
+      maxValue = std::max(maxValue, ns);
+      sum += static_cast<double>(ns);
    }
 
-   template<class T>
-   size_t RecordAdapter<T>::RowCount() const
+   void LatencyHistogram::Clear()
    {
-      return 1;
+      std::fill(counts.begin(), counts.end(), 0);
+      count = 0;
+      minValue = UINT64_MAX;
+      maxValue = 0;
+      sum = 0;
    }
 
-   template<class T>
-   T& RecordAdapter<T>::GetRecord(size_t i)
+   uint64_t LatencyHistogram::Count() const
    {
-      assert(i == 0);
-      return data;
+      return count;
    }
 
-   template<class T>
-   const T& RecordAdapter<T>::GetRecord(size_t i) const
+   uint64_t LatencyHistogram::Min() const
    {
-      assert(i == 0);
-      return data;
+      return (count == 0) ? 0 : minValue;
    }
 
-   BasicYamlParser::BasicYamlParser(ITable* pHeader, ITable* pTable) :
-                           AbstractLineParser(), pHeader(pHeader), pTable(pTable), isHeaderSection(true)
+   uint64_t LatencyHistogram::Max() const
    {
-      assert(pHeader != nullptr);
-      assert(pHeader->RowCount() > 0);
-      assert(pTable != nullptr);
-      assert(!pTable->IsFixedSize());
+      return maxValue;
    }
 
-   void BasicYamlParser::SetHeaderAdapter(ITable* newAdapter)
+   double LatencyHistogram::Mean() const
    {
-      assert(newAdapter != nullptr);
-      assert(newAdapter->RowCount() > 0);
-      pHeader = newAdapter;
+      return (count == 0) ? 0 : sum / count;
    }
 
-   void BasicYamlParser::SetTableAdapter(ITable* newAdapter)
+   uint64_t LatencyHistogram::Percentile(double fraction) const
    {
-      assert(newAdapter != nullptr);
-      assert(!newAdapter->IsFixedSize());
-      pTable = newAdapter;
+      if (count == 0) return 0;
+
+      uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * count));
+      rank = std::min(std::max<uint64_t>(rank, 1), count);
+
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts.size(); i++)
+      {
+         seen += counts[i];
+         if (seen >= rank)
+         {
+            return std::min(std::max(BucketUpperBound(i), minValue), maxValue);
+         }
+      }
+
+      return maxValue;
    }
 
-   void BasicYamlParser::PreParse()
+   void LatencyHistogram::Print(std::ostream& out) const
    {
-      isHeaderSection = true;
+      if (count == 0) return;
+
+      // the buckets of a power of two are contiguous
+      for (size_t first = 0; first < counts.size(); )
+      {
+         size_t last = (first < kSubBuckets) ? kSubBuckets : first + kSubBuckets;
+
+         uint64_t n = 0;
+         for (size_t i = first; i < last; i++) n += counts[i];
+
+         if (n > 0)
+         {
+            uint64_t from = (first < kSubBuckets) ? 0 : (kSubBuckets << (first / kSubBuckets - 1));
+            out << "  [" << from << ", " << BucketUpperBound(last - 1) + 1 << ") ns: "
+                << n << " (" << std::round(1000.0 * n / count) / 10 << "%)" << std::endl;
+         }
+
+         first = last;
+      }
    }
 
-   void BasicYamlParser::ParseLine(StringSegment s)
+   // Solves the problem set again (**options.warmupRuns** runs first, which
+   // are not measured) and reports the time of every run and percentiles
+   // of the time of one problem. The problems are timed one by one with
+   // steady_clock; the cost of reading the clock is reported as well.
+   template<class T, class Solver>
+   void BenchmarkProblemSet(std::vector<T>& problems, Solver solve, const BenchmarkOptions& options = BenchmarkOptions())
    {
-      assert(pTable != nullptr);
-
-      s.Trim();
-      if (s.IsEmpty()) return;
+      typedef std::chrono::steady_clock Clock;
 
-      char firstChar = s.FirstChar();
+      auto nanoseconds = [](Clock::duration d) -> uint64_t
+      {
+         return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+      };
 
-      if (firstChar == '#')
+      for (int run = 0; run < options.warmupRuns; run++)
       {
-         //comments
-         return;
+         for (T& theProblem : problems) solve(theProblem);
       }
-      else if (s.Match("data:"))
+
+      // the smallest difference of two readings of the clock
+      uint64_t clockOverhead = UINT64_MAX;
+      for (int i = 0; i < 1000; i++)
       {
-         //start data section
-         isHeaderSection = false;
-         return;
+         Clock::time_point t0 = Clock::now();
+         Clock::time_point t1 = Clock::now();
+         clockOverhead = std::min(clockOverhead, nanoseconds(t1 - t0));
       }
-      else if (firstChar == '-')
+
+      LatencyHistogram histogram;
+      std::vector<uint64_t> runTimes;
+
+      for (int run = 0; run < options.repetitions; run++)
       {
-         CheckCondition(!isHeaderSection, "Invalid entry in the header section.");
+         Clock::time_point tRun = Clock::now();
+         Clock::time_point tPrev = tRun;
 
-         size_t row;
-         pTable->NewRow(row);
-         s.RemovePrefix(1);
+         for (T& theProblem : problems)
+         {
+            solve(theProblem);
 
-         s.Trim();
-         if (s.IsEmpty()) return;
+            Clock::time_point tNow = Clock::now();
+            histogram.Add(nanoseconds(tNow - tPrev));
+            tPrev = tNow;
+         }
+
+         runTimes.push_back(nanoseconds(tPrev - tRun));
       }
 
-      StringSegment prefix(s);
-      s.Split(':', prefix);
-      s.Trim();
-      prefix.Trim();
+      std::sort(runTimes.begin(), runTimes.end());
 
-      CheckCondition(!s.IsEmpty() && !prefix.IsEmpty(), "Key or value is empty.");
-      if (!IsOK()) return;
+      auto ms = [](uint64_t ns) { return std::round(ns / 1e4) / 100; };
 
-      if (isHeaderSection)
+      std::cout << std::endl << "Benchmark: " << problems.size() << " problem(s), "
+                << options.repetitions << " run(s) after " << options.warmupRuns << " warm-up run(s)." << std::endl;
+
+      if (!runTimes.empty())
       {
-         CheckCondition(pHeader != nullptr, "Unexpected header.");
-         if (!IsOK()) return;
+         std::cout << "Run time: min " << ms(runTimes.front()) << "ms, median "
+                   << ms(runTimes[runTimes.size() / 2]) << "ms, max " << ms(runTimes.back()) << "ms." << std::endl;
+      }
 
-         bool bResult = pHeader->SetValue(0, prefix, s);
+      std::cout << "Time per problem: p50 " << histogram.Percentile(0.5) << "ns, p90 "
+                << histogram.Percentile(0.9) << "ns, p99 " << histogram.Percentile(0.99) << "ns, max "
+                << histogram.Max() << "ns, mean " << std::round(histogram.Mean()) << "ns "
+                << "(clock overhead " << clockOverhead << "ns)." << std::endl;
 
-         CheckCondition(bResult, "Cannot parse a line.");
-         if (!IsOK()) return;
+      if (options.bPrintHistogram)
+      {
+         histogram.Print(std::cout);
       }
-      else
+   }
+
+   SplitRandom::SplitRandom(uint64_t seed) : state(seed)
+   {
+      //empty
+   }
+
+   uint64_t SplitRandom::Mix(uint64_t z)
+   {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+   }
+
+   uint64_t SplitRandom::Next()
+   {
+      state += 0x9e3779b97f4a7c15ULL;
+      return Mix(state);
+   }
+
+   SplitRandom SplitRandom::Split(uint64_t key) const
+   {
+      return SplitRandom(Mix(state ^ Mix(key + 0x9e3779b97f4a7c15ULL)));
+   }
+
+   // Ranges up to 2^32 use a multiply-shift of 32 random bits (bias
+   // below range / 2^32), larger ones the remainder of 64 bits.
+   int64_t SplitRandom::Uniform(int64_t low, int64_t high)
+   {
+      assert(low <= high);
+
+      uint64_t range = static_cast<uint64_t>(high) - static_cast<uint64_t>(low) + 1;
+      if (range == 0) return static_cast<int64_t>(Next());
+
+      uint64_t offset = (range <= (uint64_t(1) << 32)) ? (((Next() >> 32) * range) >> 32) : (Next() % range);
+      return static_cast<int64_t>(static_cast<uint64_t>(low) + offset);
+   }
+
+   double SplitRandom::UniformReal()
+   {
+      return (Next() >> 11) * 0x1.0p-53;
+   }
+
+   SizeDistribution SizeDistribution::Fixed(size_t size)
+   {
+      return {Kind::Fixed, size, size};
+   }
+
+   SizeDistribution SizeDistribution::Uniform(size_t minSize, size_t maxSize)
+   {
+      return {Kind::Uniform, minSize, std::max(minSize, maxSize)};
+   }
+
+   SizeDistribution SizeDistribution::LogUniform(size_t minSize, size_t maxSize)
+   {
+      return {Kind::LogUniform, minSize, std::max(minSize, maxSize)};
+   }
+
+   size_t SizeDistribution::Sample(SplitRandom& random) const
+   {
+      switch (kind)
       {
-         size_t tableSize = pTable->RowCount();
-         bool bResult = pTable->SetValue(tableSize - 1, prefix, s);
+      case Kind::Uniform:
+         return static_cast<size_t>(random.Uniform(static_cast<int64_t>(minSize), static_cast<int64_t>(maxSize)));
 
-         CheckCondition(bResult, "Cannot parse a line.");
-         if (!IsOK()) return;
+      case Kind::LogUniform:
+      {
+         double logMin = std::log(static_cast<double>(std::max<size_t>(minSize, 1)));
+         double logMax = std::log(static_cast<double>(std::max<size_t>(maxSize, 1)) + 1);
+         size_t size = static_cast<size_t>(std::exp(logMin + (logMax - logMin) * random.UniformReal()));
+         return std::min(std::max(size, minSize), maxSize);
+      }
+
+      default:
+         return minSize;
       }
    }
 
-   void WriteRecordToStream(std::ostream& out, ITable* table,
-                            size_t row, bool bWriteDefaultValues,
-                            bool bIndent)
+   // Fills **problems** with options.problemCount problems without
+   // files: fill(theProblem, size, random) sets the data of a problem
+   // from its own generator, and the ids are 1, 2, ... . With a
+   // **reference** solver, correct_answer is reference(theProblem). The
+   // header is set as if the problem set had been parsed, so the set
+   // goes through PreprocessProblemSet and ProcessResults unchanged.
+   // The problems depend only on the seed, not on the number of threads.
+   template<class T, class Fill, class Reference>
+   void GenerateProblemSet(int problem_set_id, std::vector<T>& problems, ProblemSetHeader& header,
+                           const GeneratorOptions& options, Fill fill, Reference reference)
    {
-      if (bIndent) out << std::endl;
+      size_t count = options.problemCount;
 
-      size_t nCols = table->ColumnCount();
-      for (size_t j = 0; j < nCols; j++)
+      problems.clear();
+      problems.resize(count);
+
+      header.id = problem_set_id;
+      header.problem_count = static_cast<int>(count);
+
+      SplitRandom base(options.seed);
+
+      auto generate = [&](size_t begin, size_t end)
       {
-          if (bIndent && (j == 0))
-         {
-            out << " - ";
-         }
+         Profiler::RegisterThread();
 
-         if (bWriteDefaultValues || !table->EqualsDefaultValue(row, j))
+         for (size_t i = begin; i < end; i++)
          {
-            if (bIndent && (j != 0))
-            {
-               out << "   ";
-            }
+            T& theProblem = problems[i];
+            SplitRandom random = base.Split(i);
 
-            out << table->GetColumnName(j) << ": ";
-            std::string value;
-            table->GetValue(row, j, value);
-            out << value << std::endl;
+            theProblem.id = static_cast<int>(i + 1);
+            fill(theProblem, options.sizes.Sample(random), random);
+            theProblem.correct_answer = reference(static_cast<const T&>(theProblem));
          }
-      }
-   }
+      };
 
-   void WriteTableToStream(std::ostream& out, ITable* table, ITable* header /* can be nullptr */,
-                           bool bWriteDefaultValues)
-   {
-      assert(table != nullptr);
+      size_t threadCount = (options.threadCount != 0) ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+      threadCount = std::min(threadCount, std::max<size_t>(count / 64, 1));
 
-      size_t nRows = table->RowCount();
+      if (threadCount < 2)
+      {
+         generate(0, count);
+         return;
+      }
 
-      if (header != nullptr)
+      std::vector<std::thread> threads;
+      for (size_t k = 0; k < threadCount; k++)
       {
-         WriteRecordToStream(out, header, 0, bWriteDefaultValues, false);
+         threads.emplace_back(generate, count * k / threadCount, count * (k + 1) / threadCount);
       }
 
-      out << std::endl << "data:" << std::endl;
-      for (size_t i = 0; i < nRows; i++)
+      for (std::thread& thread : threads)
       {
-         WriteRecordToStream(out, table, i, bWriteDefaultValues, true);
+         thread.join();
       }
    }
 
-   void WriteTableToFile(const char* filename, ITable* header, ITable* table,
-                         bool bWriteDefaultValues, const char* comments)
+   // The same without a reference solver: correct_answer is left as
+   // fill sets it.
+   template<class T, class Fill>
+   void GenerateProblemSet(int problem_set_id, std::vector<T>& problems, ProblemSetHeader& header,
+                           const GeneratorOptions& options, Fill fill)
    {
-      std::ofstream out;
-      out.open(filename);
-      ExitIfConditionFails(out.good(), "Cannot open output file!");
+      GenerateProblemSet(problem_set_id, problems, header, options, fill,
+                         [](const T& theProblem) { return theProblem.correct_answer; });
+   }
 
-      if (comments != nullptr)
+   // Grades solved problems one at a time and in order, as ProcessResults
+   // grades a whole problem set; the checks of PreprocessProblemSet are
+   // made as the problems arrive.
+   class StreamingGrader
+   {
+   public:
+      StreamingGrader(int problem_set_id, ProblemSetHeader& header);
+
+      // Returns false, and grades no more problems, after an error.
+      template<class T>
+      bool Grade(const T& theProblem);
+
+      // Checks the number of problems, sets the time and the number of
+      // mistakes in the header and prints the summary; exits on errors.
+      void Finish();
+
+      // nullptr if there is no error.
+      const char* GetError() const;
+
+   private:
+      bool CheckCondition(bool bCondition, const char* error);
+
+   private:
+      int problem_set_id;
+      ProblemSetHeader& header;
+      int nProblems;
+      int nMistakes;
+      const char* error;
+   };
+
+   StreamingGrader::StreamingGrader(int problem_set_id, ProblemSetHeader& header) :
+      problem_set_id(problem_set_id), header(header), nProblems(0), nMistakes(0), error(nullptr)
+   {
+      //empty
+   }
+
+   bool StreamingGrader::CheckCondition(bool bCondition, const char* error)
+   {
+      if (!bCondition && (this->error == nullptr))
       {
-         out << comments;
+         this->error = error;
       }
 
-      WriteTableToStream(out, header, table, bWriteDefaultValues);
+      return (this->error == nullptr);
+   }
 
-      out.close();
+   const char* StreamingGrader::GetError() const
+   {
+      return error;
    }
 
+   // The header is parsed before the first problem.
    template<class T>
-   void PreprocessProblemSet(int problem_set_id, std::vector<T>& problems, ProblemSetHeader& header)
+   bool StreamingGrader::Grade(const T& theProblem)
    {
-      ExitIfConditionFails(header.id == problem_set_id, "Wrong problem set. Check problem set number.");
-      ExitIfConditionFails(header.problem_count == (int) problems.size(), "Input file is corrupted.");      
+      if ((nProblems == 0) && !CheckCondition(header.id == problem_set_id, "Wrong problem set. Check problem set number."))
+      {
+         return false;
+      }
 
-      for (int i = 0; i < header.problem_count; i++)
+      if (!CheckCondition((theProblem.id == nProblems + 1) && (nProblems < header.problem_count), "Input file is corrupted."))
       {
-         ExitIfConditionFails(problems[i].id == (i + 1), "Input file is corrupted.");
+         return false;
       }
 
-      header.tStart = std::chrono::high_resolution_clock::now();
+      nProblems++;
+
+      if ((theProblem.student_answer != theProblem.correct_answer))
+      {
+         nMistakes++;
+         std::cout << std::endl;
+         std::cout << "Mistake in problem #" << nProblems << "." << std::endl;
+         std::cout << "Correct answer: " << theProblem.correct_answer << "." << std::endl;
+         std::cout << "Your answer: " << theProblem.student_answer << "." << std::endl;
+         std::cout << "=========================";
+      }
+
+      return true;
    }
 
-   template<class T>
-   void ProcessResults(std::vector<T>& problems, ProblemSetHeader& header)
+   void StreamingGrader::Finish()
    {
+      if (nProblems == 0)
+      {
+         CheckCondition(header.id == problem_set_id, "Wrong problem set. Check problem set number.");
+      }
+
+      CheckCondition(header.problem_count == nProblems, "Input file is corrupted.");
+      ExitIfConditionFails(error == nullptr, error);
+
       std::chrono::high_resolution_clock::time_point tNow = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(tNow - header.tStart);
       header.time = static_cast<int>(std::round(1000 * time_span.count()));
 
-      int nMistakes = 0;
+      header.test_mistakes = nMistakes;
 
-      for (int i = 0; i < header.problem_count; i++)
+      if (nMistakes > 0)
       {
-         T& theProblem = problems[i];
+         std::cout << std::endl << "Your algorithm made " << nMistakes << " mistake(s)." << std::endl;
+      }
+      else
+      {
+         std::cout << "Your algorithm solved all test problems correctly. Congratulations!" << std::endl;
+      }
+   }
 
-         if ((theProblem.student_answer != theProblem.correct_answer))
+   // Parses the problems of a file on this thread while **solve** solves
+   // them on another thread, and grades them as they are solved. At most
+   // **capacity** parsed problems wait for the solver, so the memory used
+   // does not depend on the number of problems. The time in the header
+   // includes parsing. Exits on errors, after the solver has stopped.
+   template<class Adapter, class Solver>
+   void SolveProblemStream(const char* filename, ITable* pHeader, StreamingTable<Adapter>& table,
+                           int problem_set_id, ProblemSetHeader& header, Solver solve,
+                           size_t capacity = 1024)
+   {
+      typedef typename Adapter::DataType DataType;
+
+      BoundedQueue<DataType> queue(capacity);
+      table.SetCallback([&queue](DataType&& theProblem) { queue.Push(std::move(theProblem)); });
+
+      BasicYamlParser parser(pHeader, &table);
+      StreamingGrader grader(problem_set_id, header);
+
+      header.tStart = std::chrono::high_resolution_clock::now();
+
+      std::thread solver([&queue, &grader, &solve]
+      {
+         Profiler::RegisterThread();
+         DataType theProblem;
+
+         while (queue.Pop(theProblem))
          {
-            nMistakes++;
-            std::cout << std::endl;
-            std::cout << "Mistake in problem #" << (i + 1) << "." << std::endl;
-            std::cout << "Correct answer: " << theProblem.correct_answer << "." << std::endl;
-            std::cout << "Your answer: " << theProblem.student_answer << "." << std::endl;
-            std::cout << "=========================";
+            if (grader.GetError() != nullptr) continue;
+
+            {
+               Trace::Span span("Solve", "solver");
+               solve(theProblem);
+            }
+
+            grader.Grade(theProblem);
          }
-      }
+      });
 
-      header.test_mistakes = nMistakes;
+      parser.ParseFile(filename, false);
 
-      if (nMistakes > 0)
+      if (parser.IsOK())
       {
-         std::cout << std::endl << "Your algorithm made " << nMistakes << " mistake(s)." << std::endl;
+         queue.Close();
       }
       else
       {
-         std::cout << "Your algorithm solved all test problems correctly. Congratulations!" << std::endl;
+         queue.Cancel();
       }
+
+      solver.join();
+      table.SetCallback(nullptr);
+
+      parser.ExitOnError();
+      grader.Finish();
    }
 }
 
-#endif //_test_framework_h_
\ No newline at end of file
+#endif //_test_framework_h_
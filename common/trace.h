@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////////
+// Timeline tracing in the Chrome trace-event format.
+//
+// A Span records the time from its creation to its destruction. Every
+// thread records its spans in a ring buffer of its own, without locks;
+// when a buffer is full, the oldest spans are overwritten. When a thread
+// exits, its buffer, with its spans, goes to the next thread that needs
+// one, so there are only as many buffers as threads that run at once.
+// At exit (or on Flush), the spans in all buffers are written as
+// trace-event JSON, which chrome://tracing and Perfetto
+// (ui.perfetto.dev) can load.
+//
+// Tracing is off unless the environment variable TRACE_FILE names the
+// output file or Enable is called; a span then costs one load and a
+// branch. Names and categories must be string literals (only the
+// pointers are stored).
+//
+// Example:
+//   TRACE_FILE=trace.json ./scheduler.out
+//
+//   void Solve(Problem& problem)
+//   {
+//      Trace::Span span("Solve");
+//      ...
+//   }
+//
+
+#ifndef _trace_h_
+#define _trace_h_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Trace
+{
+   struct Event
+   {
+      const char* name;
+      const char* category;
+      uint64_t start;     // ns
+      uint64_t duration;  // ns
+   };
+
+   // The spans of one thread. Only the thread writes to its buffer.
+   // Buffers are never freed, so the spans of threads that have exited
+   // are written too; a buffer is reused by a later thread, which keeps
+   // its threadId (the threads do not overlap in time).
+   struct ThreadBuffer
+   {
+      static constexpr size_t kCapacity = size_t(1) << 16;
+
+      Event events[kCapacity];
+      std::atomic<uint64_t> count{0};
+      uint32_t threadId = 0;
+      ThreadBuffer* next = nullptr;
+      ThreadBuffer* nextFree = nullptr;
+   };
+
+   bool IsEnabled();
+
+   // Starts recording spans; they are written to **filename** at exit.
+   void Enable(const char* filename);
+
+   // Writes the spans recorded so far; returns false if the file
+   // cannot be written. Threads should not be recording meanwhile.
+   bool Flush();
+
+   // Nanoseconds from an arbitrary origin (steady_clock).
+   uint64_t Now();
+
+   // Records a span of the calling thread.
+   void AddEvent(const char* name, const char* category, uint64_t start, uint64_t end);
+
+   class Span
+   {
+   public:
+      Span(const char* name, const char* category = "user");
+      ~Span();
+
+      Span(const Span&) = delete;
+      Span& operator=(const Span&) = delete;
+
+   private:
+      const char* name;
+      const char* category;
+      uint64_t start;
+   };
+
+   ///////////////////////////////////////////////////////////////////////////////
+
+   namespace Detail
+   {
+      struct State
+      {
+         std::atomic<bool> bEnabled{false};
+         std::atomic<ThreadBuffer*> buffers{nullptr};
+         std::atomic<uint32_t> nThreads{0};
+         std::mutex fileMutex;
+         std::string filename;
+
+         // the buffers of the threads that have exited
+         std::mutex freeMutex;
+         ThreadBuffer* freeBuffers = nullptr;
+      };
+
+      State& GetState()
+      {
+         static State state;
+         return state;
+      }
+
+      // Takes a free buffer, or makes a new one.
+      ThreadBuffer* AcquireBuffer()
+      {
+         State& state = GetState();
+
+         {
+            std::lock_guard<std::mutex> lock(state.freeMutex);
+
+            if (state.freeBuffers != nullptr)
+            {
+               ThreadBuffer* buffer = state.freeBuffers;
+               state.freeBuffers = buffer->nextFree;
+               return buffer;
+            }
+         }
+
+         ThreadBuffer* buffer = new ThreadBuffer();
+         buffer->threadId = state.nThreads.fetch_add(1, std::memory_order_relaxed) + 1;
+         buffer->next = state.buffers.load(std::memory_order_relaxed);
+
+         while (!state.buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+         {
+            //empty
+         }
+
+         return buffer;
+      }
+
+      void ReleaseBuffer(ThreadBuffer* buffer)
+      {
+         State& state = GetState();
+
+         std::lock_guard<std::mutex> lock(state.freeMutex);
+         buffer->nextFree = state.freeBuffers;
+         state.freeBuffers = buffer;
+      }
+
+      // Holds the buffer of a thread and releases it when the thread exits.
+      struct ThreadBufferHolder
+      {
+         ThreadBuffer* buffer = AcquireBuffer();
+
+         ~ThreadBufferHolder()
+         {
+            ReleaseBuffer(buffer);
+         }
+      };
+
+      ThreadBuffer& GetThreadBuffer()
+      {
+         thread_local ThreadBufferHolder holder;
+         return *holder.buffer;
+      }
+
+      void WriteJsonString(FILE* file, const char* str)
+      {
+         std::fputc('"', file);
+
+         for (const char* p = (str != nullptr) ? str : ""; *p != 0; p++)
+         {
+            if ((*p == '"') || (*p == '\\'))
+            {
+               std::fputc('\\', file);
+               std::fputc(*p, file);
+            }
+            else if (static_cast<unsigned char>(*p) < 0x20)
+            {
+               std::fprintf(file, "\\u%04x", static_cast<unsigned>(*p));
+            }
+            else
+            {
+               std::fputc(*p, file);
+            }
+         }
+
+         std::fputc('"', file);
+      }
+
+      void FlushAtExit()
+      {
+         Flush();
+      }
+
+      // Reads TRACE_FILE once, before main.
+      bool EnableFromEnvironment()
+      {
+         const char* filename = std::getenv("TRACE_FILE");
+         if ((filename != nullptr) && (*filename != 0)) Enable(filename);
+         return true;
+      }
+
+      const bool bEnvironmentRead = EnableFromEnvironment();
+   }
+
+   bool IsEnabled()
+   {
+      return Detail::GetState().bEnabled.load(std::memory_order_relaxed);
+   }
+
+   void Enable(const char* filename)
+   {
+      Detail::State& state = Detail::GetState();
+
+      std::lock_guard<std::mutex> lock(state.fileMutex);
+
+      if (state.filename.empty())
+      {
+         std::atexit(Detail::FlushAtExit);
+      }
+
+      state.filename = filename;
+      state.bEnabled.store(true, std::memory_order_relaxed);
+   }
+
+   uint64_t Now()
+   {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count());
+   }
+
+   // The count is published after the event is written.
+   void AddEvent(const char* name, const char* category, uint64_t start, uint64_t end)
+   {
+      ThreadBuffer& buffer = Detail::GetThreadBuffer();
+      uint64_t count = buffer.count.load(std::memory_order_relaxed);
+
+      Event& event = buffer.events[count % ThreadBuffer::kCapacity];
+      event.name = name;
+      event.category = category;
+      event.start = start;
+      event.duration = end - start;
+
+      buffer.count.store(count + 1, std::memory_order_release);
+   }
+
+   // Timestamps are relative to the earliest span, in microseconds
+   // (the unit of the format) with nanosecond fractions.
+   bool Flush()
+   {
+      Detail::State& state = Detail::GetState();
+
+      std::lock_guard<std::mutex> lock(state.fileMutex);
+      if (state.filename.empty()) return true;
+
+      ThreadBuffer* buffers = state.buffers.load(std::memory_order_acquire);
+
+      uint64_t origin = UINT64_MAX;
+      for (ThreadBuffer* buffer = buffers; buffer != nullptr; buffer = buffer->next)
+      {
+         uint64_t count = buffer->count.load(std::memory_order_acquire);
+         uint64_t first = (count > ThreadBuffer::kCapacity) ? count - ThreadBuffer::kCapacity : 0;
+
+         for (uint64_t i = first; i < count; i++)
+         {
+            origin = std::min(origin, buffer->events[i % ThreadBuffer::kCapacity].start);
+         }
+      }
+
+      FILE* file = std::fopen(state.filename.c_str(), "w");
+      if (file == nullptr) return false;
+
+      std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+      bool bFirst = true;
+
+      for (ThreadBuffer* buffer = buffers; buffer != nullptr; buffer = buffer->next)
+      {
+         std::fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                            "\"args\":{\"name\":\"thread %u\"}}",
+                      bFirst ? "" : ",", buffer->threadId, buffer->threadId);
+         bFirst = false;
+
+         uint64_t count = buffer->count.load(std::memory_order_acquire);
+         uint64_t first = (count > ThreadBuffer::kCapacity) ? count - ThreadBuffer::kCapacity : 0;
+
+         for (uint64_t i = first; i < count; i++)
+         {
+            const Event& event = buffer->events[i % ThreadBuffer::kCapacity];
+
+            std::fputs(",\n{\"name\":", file);
+            Detail::WriteJsonString(file, event.name);
+            std::fputs(",\"cat\":", file);
+            Detail::WriteJsonString(file, event.category);
+            std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         buffer->threadId, (event.start - origin) / 1000.0, event.duration / 1000.0);
+         }
+      }
+
+      std::fputs("\n]}\n", file);
+      return (std::fclose(file) == 0);
+   }
+
+   Span::Span(const char* name, const char* category) :
+      name(name), category(category), start(IsEnabled() ? Now() : 0)
+   {
+      //empty
+   }
+
+   Span::~Span()
+   {
+      if (start != 0)
+      {
+         AddEvent(name, category, start, Now());
+      }
+   }
+}
+
+#endif //_trace_h_
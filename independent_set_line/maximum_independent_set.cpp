@@ -19,6 +19,8 @@
 #include <string>
 #include <vector>
 
+#include "../common/solver_benchmark.h"
+
 // An example of a dynamic programming algorithm for finding 
 // the maximum independent set. This algorithm uses a bottom-up 
 // approach.
@@ -174,5 +176,19 @@ int main (int argc, char *argv[])
    std::cout << "  Bottom-up approach: " << FindIndependentSet_BottomUp(example5) << std::endl;
    std::cout << "  Top-down approach: "  << FindIndependentSet_TopDown (example5) << std::endl;
    std::cout << std::endl;
+
+   // --compare: time both approaches on the examples.
+   if ((argc > 1) && (std::string(argv[1]) == "--compare"))
+   {
+      typedef std::vector<int> Weights;
+
+      SolverBenchmark::Registry<Weights> registry;
+      registry.Add("bottom-up", FindIndependentSet_BottomUp);
+      registry.Add("top-down", FindIndependentSet_TopDown);
+
+      std::vector<Weights> examples = {example1, example2, example3, example4, example5};
+      SolverBenchmark::PrintResults(std::cout, SolverBenchmark::Run(registry, examples));
+   }
+
    return 0;
 }
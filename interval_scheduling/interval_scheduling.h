@@ -4,6 +4,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <cstdint>
 #include <vector> 
 
 #include "../common/concise.h"
@@ -37,5 +38,29 @@ int FindMaxSchedule (std::vector<Job> jobs)
       }
    }
 
+   return count;
+}
+
+// The same algorithm for jobs stored by columns: job i starts at
+// start[i] and finishes at finish[i].
+int FindMaxSchedule (const std::vector<int>& start, 
+                     const std::vector<int>& finish)
+{
+   //order of jobs by finish time
+   //we use functions defined in "concise.h"
+   std::vector<std::uint32_t> order = alg::argsort_by(finish);
+   int count = 0;
+   int previousFinishTime = 0;
+
+   for (auto i : order)
+   {
+      //check that the job does not intersect with the previous one
+      if (start[i] >= previousFinishTime)
+      {
+         count++;
+         previousFinishTime = finish[i];
+      }
+   }
+
    return count;
 }
\ No newline at end of file
@@ -4,13 +4,23 @@
 // To compile with **clang++** or **g++** type:
 //   clang++ -std=c++17 -pedantic -Wall scheduler.cpp -O3 -o scheduler.out
 //   g++ -std=c++17 -pedantic -Wall scheduler.cpp -O3 -o scheduler.out
+//
+// Add -DALLOC_TRACKER to count heap allocations (the --allocations mode).
 
 
+#include <cstdlib>
 #include <string>
 #include <vector>
 
 #include "interval_scheduling.h"
 #include "../common/test_framework.h"
+#include "../common/perf_counters.h"
+#include "../common/solver_benchmark.h"
+#include "../common/scaling_study.h"
+
+#if defined(ALLOC_TRACKER)
+#include "../common/alloc_tracker.h"
+#endif
 
 const char* inputFilename = "data/intervals.in";
 
@@ -23,6 +33,15 @@ struct IntervalSchedulingProblem : public TestFramework::BasicProblem
    std::vector<int> right;
 };
 
+constexpr auto kProblemSchema = TestFramework::MakeSchema<IntervalSchedulingProblem>(
+   TestFramework::MakeColumn<IntervalSchedulingProblem>("problem", &IntervalSchedulingProblem::id),
+   TestFramework::MakeColumn<IntervalSchedulingProblem>("correct_answer", 
+                              &IntervalSchedulingProblem::correct_answer),
+   TestFramework::MakeColumn<IntervalSchedulingProblem, std::vector<int>>("left", 
+                              &IntervalSchedulingProblem::left),
+   TestFramework::MakeColumn<IntervalSchedulingProblem, std::vector<int>>("right", 
+                              &IntervalSchedulingProblem::right));
+
 int FindMaxScheduleHelper (const std::vector<int>& left,
                            const std::vector<int>& right)
 {
@@ -30,21 +49,61 @@ int FindMaxScheduleHelper (const std::vector<int>& left,
       "Invalid data. Arrays of the left and right endpoints have different sizes.");
 
    size_t size = left.size();
-   std::vector<Job> jobs;
-   jobs.reserve (size);
 
    for (size_t i = 0; i < size; i++)
    {
       TestFramework::ExitIfConditionFails (right[i] >= left[i], 
                "Left endpoint is greater that the right endpoint. "
                "Please, check the input file.");
-
-      jobs.push_back ({left[i],right[i]});
    }
    
+   return FindMaxSchedule (left, right);
+}
+
+void SolveProblem (IntervalSchedulingProblem& theProblem)
+{
+   theProblem.student_answer = 
+            FindMaxScheduleHelper (theProblem.left, theProblem.right);
+}
+
+// The algorithm for an array of Job structs.
+int SolveWithJobs (const IntervalSchedulingProblem& theProblem)
+{
+   std::vector<Job> jobs(std::min(theProblem.left.size(), theProblem.right.size()));
+
+   for (size_t i = 0; i < jobs.size(); i++)
+   {
+      jobs[i].start = theProblem.left[i];
+      jobs[i].finish = theProblem.right[i];
+   }
+
    return FindMaxSchedule (jobs);
 }
 
+// Random intervals with endpoints below 2^30 and lengths below 2^20.
+void FillProblem (IntervalSchedulingProblem& theProblem, size_t size,
+                  TestFramework::SplitRandom& random)
+{
+   theProblem.left.resize(size);
+   theProblem.right.resize(size);
+
+   for (size_t i = 0; i < size; i++)
+   {
+      theProblem.left[i] = static_cast<int>(random.Uniform(0, 1 << 30));
+      theProblem.right[i] = theProblem.left[i] + static_cast<int>(random.Uniform(0, 1 << 20));
+   }
+}
+
+// The variants compared by --compare: jobs stored by columns (as above)
+// and as an array of Job structs.
+const bool bVariantsRegistered =
+   SolverBenchmark::RegisterSolver<IntervalSchedulingProblem>("columns",
+      [](const IntervalSchedulingProblem& theProblem)
+      {
+         return FindMaxScheduleHelper (theProblem.left, theProblem.right);
+      }) &&
+   SolverBenchmark::RegisterSolver<IntervalSchedulingProblem>("jobs", SolveWithJobs);
+
 
 int main(int argc, char *argv[])
 {
@@ -55,36 +114,171 @@ int main(int argc, char *argv[])
                   "Please, update test_framework.h.");
 
    ProblemSetHeader header;
-   RecordAdapter<ProblemSetHeader> psAdapter(header); 
-   AddDefaultProblemSetColumns(psAdapter);
+   StaticRecordAdapter<kProblemSetSchema> psAdapter(header); 
+
+   // --stream: solve problems while the file is parsed, keeping only
+   // a few of them in memory.
+   if ((argc > 1) && (std::string(argv[1]) == "--stream"))
+   {
+      StreamingTable<StaticTableAdapter<kProblemSchema>> prStream;
+
+      std::cout << std::endl;
+      SolveProblemStream(inputFilename, &psAdapter, prStream, problem_set_id, header,
+                         SolveProblem);
+
+      std::cout << "Running time: " << header.time << "ms."
+                << std::endl << std::endl;
+      return 0;
+   }
+
+   // --generate count [seed]: solve problems generated in memory; the
+   // answers of the Job version of the algorithm are the correct ones.
+   if ((argc > 2) && (std::string(argv[1]) == "--generate"))
+   {
+      GeneratorOptions options;
+      options.problemCount = std::strtoull(argv[2], nullptr, 10);
+      options.sizes = SizeDistribution::LogUniform(1, 1000);
+
+      if (argc > 3)
+      {
+         options.seed = std::strtoull(argv[3], nullptr, 10);
+      }
+
+      std::vector<IntervalSchedulingProblem> problems;
+      GenerateProblemSet(problem_set_id, problems, header, options, FillProblem, SolveWithJobs);
+
+      PreprocessProblemSet(problem_set_id, problems, header);
+
+      for (IntervalSchedulingProblem& theProblem : problems)
+      {
+         SolveProblem(theProblem);
+      }
+
+      std::cout << std::endl;
+      ProcessResults(problems, header);
+      std::cout << "Running time: " << header.time << "ms."
+                << std::endl << std::endl;
+      return 0;
+   }
 
    std::vector<IntervalSchedulingProblem> problems;
-   TableAdapter<IntervalSchedulingProblem> prAdapter(problems);
-   AddDefaultProblemColumns (prAdapter);
- 
-   AddColumn<IntervalSchedulingProblem>(prAdapter, "left", 
-                              &IntervalSchedulingProblem::left);
-
-   AddColumn<IntervalSchedulingProblem>(prAdapter, "right", 
-                              &IntervalSchedulingProblem::right);
+   StaticTableAdapter<kProblemSchema> prAdapter(problems);
         
    BasicYamlParser parser(dynamic_cast<ITable*>(&psAdapter), 
                           dynamic_cast<ITable*>(&prAdapter));
 
+#if defined(ALLOC_TRACKER)
+   // --allocations: heap allocations of the phases and of every problem.
+   if ((argc > 1) && (std::string(argv[1]) == "--allocations"))
+   {
+      AllocTracker::AllocationScope parseScope(AllocTracker::AllocationScope::Threads::All);
+      parser.ParseFile(inputFilename, true);
+      AllocTracker::Stats parseAllocations = parseScope.Stop();
+
+      PreprocessProblemSet(problem_set_id, problems, header);
+
+      AllocTracker::AllocationScope solveScope;
+
+      for (IntervalSchedulingProblem& theProblem : problems)
+      {
+         SolveProblem(theProblem);
+      }
+
+      AllocTracker::Stats solveAllocations = solveScope.Stop();
+
+      std::cout << std::endl;
+      AllocTracker::AllocationScope gradeScope;
+      ProcessResults(problems, header);
+      AllocTracker::Stats gradeAllocations = gradeScope.Stop();
+      std::cout << "Running time: " << header.time << "ms."
+                << std::endl;
+
+      std::cout << std::endl << "Allocations by phase:" << std::endl;
+      AllocTracker::Print(std::cout, "parse (all threads)", parseAllocations);
+      AllocTracker::Print(std::cout, "solve", solveAllocations);
+      AllocTracker::Print(std::cout, "grade", gradeAllocations);
+
+      AllocTracker::TrackProblemSet(problems, SolveProblem);
+      std::cout << "Peak RSS: " << AllocTracker::PeakRss() << " bytes."
+                << std::endl << std::endl;
+      return 0;
+   }
+#endif
+
    parser.ParseFile(inputFilename, true);
 
    PreprocessProblemSet(problem_set_id, problems, header);
 
    for (int i = 0; i < header.problem_count; i++)
    {
-      IntervalSchedulingProblem& theProblem = problems[i];
-      
-      theProblem.student_answer = 
-               FindMaxScheduleHelper (theProblem.left, theProblem.right);
+      Trace::Span span("Solve", "solver");
+      SolveProblem(problems[i]);
    }
 
    std::cout << std::endl;
    ProcessResults(problems, header);
    std::cout << "Running time: " << header.time << "ms."
-             << std::endl << std::endl;
+             << std::endl;
+
+   // --benchmark [runs]: time the solver on the problem set repeatedly.
+   if ((argc > 1) && (std::string(argv[1]) == "--benchmark"))
+   {
+      BenchmarkOptions options;
+      options.bPrintHistogram = true;
+
+      if (argc > 2)
+      {
+         options.repetitions = std::max(1, std::atoi(argv[2]));
+      }
+
+      BenchmarkProblemSet(problems, SolveProblem, options);
+   }
+
+   // --counters: hardware counters of the solver.
+   if ((argc > 1) && (std::string(argv[1]) == "--counters"))
+   {
+      PerfCounters::CountProblemSet(problems, SolveProblem);
+   }
+
+   // --compare [--flush-cache]: time the registered solver variants.
+   if ((argc > 1) && (std::string(argv[1]) == "--compare"))
+   {
+      SolverBenchmark::Options options;
+      options.bFlushCache = (argc > 2) && (std::string(argv[2]) == "--flush-cache");
+
+      SolverBenchmark::PrintResults(std::cout, 
+         SolverBenchmark::Run(SolverBenchmark::Registry<IntervalSchedulingProblem>::Global(),
+                              problems, options));
+   }
+
+   // --scaling: growth of the running time of the solver, which
+   // should be O(n log n) in the number of intervals.
+   if ((argc > 1) && (std::string(argv[1]) == "--scaling"))
+   {
+      ScalingStudy::Expectation nLogN;
+      nLogN.exponent = 1;
+      nLogN.logExponent = 1;
+
+      ScalingStudy::Options options;
+      options.maxLog2 = 24;
+
+      ScalingStudy::Result result = ScalingStudy::Run(
+         [](size_t n)
+         {
+            SplitRandom random(n);
+            IntervalSchedulingProblem theProblem;
+            FillProblem(theProblem, n, random);
+            return theProblem;
+         },
+         [](const IntervalSchedulingProblem& theProblem)
+         {
+            FindMaxScheduleHelper (theProblem.left, theProblem.right);
+         }, nLogN, options);
+
+      ScalingStudy::PrintResult(std::cout, "FindMaxSchedule", result, nLogN);
+
+      if (!result.bPassed) return 1;
+   }
+
+   std::cout << std::endl;
 }
\ No newline at end of file
@@ -16,10 +16,14 @@
 //
 // Try running this code with a regular text file and with a 
 // file that contains really large strings (say, 1 million characters).
+// Run it with --scaling to measure how the running time grows.
 
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <string>
+
+#include "../common/scaling_study.h"
 
 const int bufferSize = 10000000;
 
@@ -38,8 +42,63 @@ void ReplaceSpaces(char* str)
    }
 }
 
+// The same function computing the length once.
+void ReplaceSpacesLinear(char* str)
+{
+   size_t length = std::strlen(str);
+
+   for (size_t i = 0; i < length; i++)
+   {
+      if (std::isspace(str[i]))
+      {
+         str[i] = '-';
+      }
+   }
+}
+
+// Both functions should take linear time; ReplaceSpaces does not.
+bool RunScalingStudy()
+{
+   ScalingStudy::Expectation linear;
+   linear.exponent = 1;
+
+   // larger strings do not fit in the caches, which adds the growth
+   // of the memory access time to the fit
+   ScalingStudy::Options options;
+   options.maxLog2 = 20;
+   options.maxSecondsPerSize = 0.5;
+
+   auto generate = [](size_t n)
+   {
+      std::string str(n, 'a');
+      for (size_t i = 0; i < n; i += 8) str[i] = ' ';
+      return str;
+   };
+
+   // the functions change the string, so every run gets a copy
+   // (in the same buffer)
+   static std::string str;
+
+   ScalingStudy::Result linearResult = ScalingStudy::Run(generate, 
+      [](const std::string& input) { str = input; ReplaceSpacesLinear(&str[0]); },
+      linear, options);
+   ScalingStudy::PrintResult(std::cout, "ReplaceSpacesLinear", linearResult, linear);
+
+   ScalingStudy::Result result = ScalingStudy::Run(generate, 
+      [](const std::string& input) { str = input; ReplaceSpaces(&str[0]); },
+      linear, options);
+   ScalingStudy::PrintResult(std::cout, "ReplaceSpaces", result, linear);
+
+   return linearResult.bPassed && result.bPassed;
+}
+
 int main(int argc, char *argv[])
 {
+   if ((argc == 2) && (std::string(argv[1]) == "--scaling"))
+   {
+      return RunScalingStudy() ? 0 : 1;
+   }
+
    if (argc != 3)
    {
       std::cerr << "Please, specify the input and output file names." << std::endl;